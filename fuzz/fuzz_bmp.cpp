@@ -0,0 +1,13 @@
+// libFuzzer target for the BMP decoder, see README.md in this directory
+#include <cstddef>
+#include <cstdint>
+
+#include "../src/imagedata.h"
+
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const * data, size_t size)
+{
+    tex::ImageData id;
+    tex::DecodeBMP(data, size, id);
+
+    return 0;
+}
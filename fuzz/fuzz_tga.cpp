@@ -0,0 +1,13 @@
+// libFuzzer target for the TGA decoder, see README.md in this directory
+#include <cstddef>
+#include <cstdint>
+
+#include "../src/imagedata.h"
+
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const * data, size_t size)
+{
+    tex::ImageData id;
+    tex::DecodeTGA(data, size, id);
+
+    return 0;
+}
@@ -22,7 +22,7 @@ INCLUDEPATH += $$PWD/include
 LIBS += -L$$PWD/lib
 
 unix:{
-    LIBS += -lglfw -lGL -lGLEW
+    LIBS += -lglfw -lGL -lGLEW -lpthread
 }
 win32:{
     LIBS += -lglfw3dll -lopengl32 -lglew32.dll
@@ -31,10 +31,38 @@ win32:{
 }
 
 SOURCES += \
+    src/asyncloader.cpp \
+    src/atlas.cpp \
+    src/culling.cpp \
+    src/filewatch.cpp \
+    src/framecapture.cpp \
+    src/glstate.cpp \
+    src/gpuprofiler.cpp \
     src/imagedata.cpp \
     src/main.cpp \
+    src/mesh.cpp \
+    src/renderqueue.cpp \
+    src/spritebatch.cpp \
+    src/texturereload.cpp \
     src/window.cpp
 
+# qmake CONFIG+=decode_bench adds --decode-bench and the unchecked reference decoders
+decode_bench {
+    DEFINES += DECODE_BENCH
+    SOURCES += src/imagedata_bench.cpp
+}
+
 HEADERS += \
+    src/asyncloader.h \
+    src/atlas.h \
+    src/culling.h \
+    src/filewatch.h \
+    src/framecapture.h \
+    src/glstate.h \
+    src/gpuprofiler.h \
     src/imagedata.h \
+    src/mesh.h \
+    src/renderqueue.h \
+    src/spritebatch.h \
+    src/texturereload.h \
     src/window.h
@@ -0,0 +1,331 @@
+#include "asyncloader.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+// texture of a finished load against the image it was decoded from, on the current context
+bool TextureMatches(AsyncLoader::Loaded const & l)
+{
+    tex::ImageData const & img = l.image;
+    if(!img.data || l.width != img.width || l.height != img.height)
+        return false;
+
+    bool   rgb  = img.type == tex::ImageData::PixelType::pt_rgb;
+    size_t size = static_cast<size_t>(img.width) * img.height * (rgb ? 3 : 4);
+    auto   read = std::make_unique<uint8_t[]>(size);
+
+    GLint pack_alignment{4};
+    glGetIntegerv(GL_PACK_ALIGNMENT, &pack_alignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, l.name);
+    glGetTexImage(GL_TEXTURE_2D, 0, rgb ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, read.get());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, pack_alignment);
+
+    return glGetError() == GL_NO_ERROR && std::memcmp(read.get(), img.data.get(), size) == 0;
+}
+}   // namespace
+
+AsyncLoader::AsyncLoader() : mp_context_win{nullptr}, m_has_sync{false}, m_next_ticket{1}, m_stop{false} {}
+
+AsyncLoader::~AsyncLoader()
+{
+    // stop() must have run on the main thread, only make sure the thread is gone
+    if(m_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+    }
+}
+
+void AsyncLoader::start(GLFWwindow * share)
+{
+    if(isRunning())
+        return;
+
+    m_has_sync = GLEW_ARB_sync;
+
+    // the hints match Window::create so both contexts are compatible
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+    mp_context_win = glfwCreateWindow(1, 1, "", nullptr, share);
+    glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+
+    if(mp_context_win == nullptr)
+        throw std::runtime_error{"Failed to create the loader context"};
+
+    m_stop   = false;
+    m_thread = std::thread(&AsyncLoader::loaderLoop, this);
+}
+
+void AsyncLoader::stop()
+{
+    if(!isRunning())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_jobs.clear();
+    }
+    m_cv.notify_all();
+    m_thread.join();
+
+    // nobody picked these up, the objects are shared so the current context can free them
+    for(auto & d : m_done)
+    {
+        if(d.fence != nullptr)
+            glDeleteSync(d.fence);
+        if(d.result.name == 0)
+            continue;
+
+        if(d.result.target == GL_TEXTURE_2D)
+            glDeleteTextures(1, &d.result.name);
+        else
+            glDeleteBuffers(1, &d.result.name);
+    }
+    m_done.clear();
+
+    glfwDestroyWindow(mp_context_win);
+    mp_context_win = nullptr;
+}
+
+AsyncLoader::Ticket AsyncLoader::push(Job && job)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    job.ticket = m_next_ticket++;
+    Ticket t   = job.ticket;
+    m_jobs.push_back(std::move(job));
+    m_cv.notify_one();
+
+    return t;
+}
+
+AsyncLoader::Ticket AsyncLoader::loadTexture(std::string const & path, bool keep_image)
+{
+    Job job;
+    job.kind       = JobKind::jk_texture_file;
+    job.path       = path;
+    job.keep_image = keep_image;
+
+    return push(std::move(job));
+}
+
+AsyncLoader::Ticket AsyncLoader::uploadTexture(tex::ImageData && image)
+{
+    Job job;
+    job.kind  = JobKind::jk_texture_data;
+    job.image = std::move(image);
+
+    return push(std::move(job));
+}
+
+AsyncLoader::Ticket AsyncLoader::uploadBuffer(GLenum target, std::vector<uint8_t> && data, GLenum usage)
+{
+    Job job;
+    job.kind   = JobKind::jk_buffer;
+    job.target = target;
+    job.usage  = usage;
+    job.data   = std::move(data);
+
+    return push(std::move(job));
+}
+
+void AsyncLoader::loaderLoop()
+{
+    glfwMakeContextCurrent(mp_context_win);
+    // nothing else uses this context; decoded rows are tightly packed, RGB rows of odd
+    // widths are not 4-byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for(;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+            if(m_stop)
+                break;
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        Done done;
+        process(job, done);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_done.push_back(std::move(done));
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
+
+void AsyncLoader::process(Job & job, Done & done)
+{
+    Loaded & res = done.result;
+    res.ticket   = job.ticket;
+
+    if(job.kind == JobKind::jk_buffer)
+    {
+        res.target = job.target;
+        glGenBuffers(1, &res.name);
+        glBindBuffer(job.target, res.name);
+        glBufferData(job.target, static_cast<GLsizeiptr>(job.data.size()), job.data.data(), job.usage);
+        glBindBuffer(job.target, 0);
+    }
+    else
+    {
+        res.target = GL_TEXTURE_2D;
+        if(job.kind == JobKind::jk_texture_file && !tex::ReadImage(job.path, job.image))
+            return;
+
+        tex::ImageData const & img = job.image;
+        if(!img.data)
+            return;
+
+        glGenTextures(1, &res.name);
+        glBindTexture(GL_TEXTURE_2D, res.name);
+        glTexImage2D(GL_TEXTURE_2D, 0, img.type == tex::ImageData::PixelType::pt_rgb ? 3 : 4,
+                     static_cast<GLsizei>(img.width), static_cast<GLsizei>(img.height), 0,
+                     img.type == tex::ImageData::PixelType::pt_rgb ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE,
+                     img.data.get());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        res.width  = img.width;
+        res.height = img.height;
+        if(job.keep_image)
+            res.image = std::move(job.image);
+    }
+
+    // the fence has to reach the GPU before another context can wait on it
+    if(m_has_sync)
+    {
+        done.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+    }
+    else
+    {
+        glFinish();
+    }
+
+    res.ok = true;
+}
+
+void AsyncLoader::poll(std::vector<Loaded> & finished)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // fences of one context signal in order, stop at the first one still pending
+    while(!m_done.empty())
+    {
+        Done & d = m_done.front();
+        if(d.fence != nullptr)
+        {
+            if(glClientWaitSync(d.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                break;
+
+            glDeleteSync(d.fence);
+            d.fence = nullptr;
+        }
+
+        finished.push_back(std::move(d.result));
+        m_done.pop_front();
+    }
+}
+
+//==============================================================================
+//         Headless check
+//==============================================================================
+bool AsyncLoaderTest(std::string const & file_name)
+{
+    using Clock = std::chrono::steady_clock;
+
+    if(!glfwInit())
+    {
+        std::cout << "Failed to initialize GLFW" << std::endl;
+        return false;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+    GLFWwindow * win = glfwCreateWindow(1, 1, "", nullptr, nullptr);
+    glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+
+    bool ok = false;
+    if(win == nullptr)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+    }
+    else
+    {
+        glfwMakeContextCurrent(win);
+        if(glewInit() != GLEW_OK)
+        {
+            std::cout << "Failed to initialize GLEW" << std::endl;
+        }
+        else
+        {
+            std::cout << "Renderer: " << glGetString(GL_RENDERER) << ", ARB_sync "
+                      << (GLEW_ARB_sync ? "yes" : "no") << std::endl;
+
+            AsyncLoader loader;
+            try
+            {
+                loader.start(win);
+
+                auto                             start  = Clock::now();
+                AsyncLoader::Ticket              ticket = loader.loadTexture(file_name, true);
+                std::vector<AsyncLoader::Loaded> finished;
+                while(finished.empty() && Clock::now() - start < std::chrono::seconds{10})
+                {
+                    loader.poll(finished);
+                    if(finished.empty())
+                        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+                }
+                double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+                if(finished.empty())
+                {
+                    std::cout << file_name << ": no result after " << ms << " ms" << std::endl;
+                }
+                else
+                {
+                    auto const & l = finished.front();
+                    ok             = l.ticket == ticket && l.ok && l.target == GL_TEXTURE_2D && TextureMatches(l);
+                    std::cout << file_name << ": " << l.width << "x" << l.height << " after " << ms << " ms, "
+                              << (ok ? "texture matches the decoded image" : "FAILED") << std::endl;
+                }
+
+                for(auto & l : finished)
+                {
+                    if(l.name != 0)
+                        glDeleteTextures(1, &l.name);
+                }
+            }
+            catch(const std::exception & e)
+            {
+                std::cout << "ERROR: " << e.what() << std::endl;
+            }
+            loader.stop();
+        }
+        glfwDestroyWindow(win);
+    }
+
+    glfwTerminate();
+
+    return ok;
+}
@@ -0,0 +1,106 @@
+#ifndef ASYNCLOADER_H
+#define ASYNCLOADER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Include GLEW
+#include <GL/glew.h>
+// Include GLFW
+#include <GLFW/glfw3.h>
+
+#include "imagedata.h"
+
+// Background uploader. A loader thread owns a hidden GLFW window whose context shares
+// objects with the main one; textures and buffers are created and filled there, fenced
+// with glFenceSync and handed to the render thread only once the fence has signaled, so
+// neither decoding nor the upload shows up in frame time. Without ARB_sync the loader
+// thread calls glFinish instead.
+class AsyncLoader
+{
+public:
+    using Ticket = uint64_t;
+
+    struct Loaded
+    {
+        Ticket         ticket = 0;
+        bool           ok     = false;
+        GLenum         target = 0;   // GL_TEXTURE_2D or the buffer target
+        GLuint         name   = 0;   // owned by the receiver
+        uint32_t       width  = 0;
+        uint32_t       height = 0;
+        tex::ImageData image;        // decoded texture data if it was asked for
+    };
+
+private:
+    enum class JobKind
+    {
+        jk_texture_file,
+        jk_texture_data,
+        jk_buffer
+    };
+
+    struct Job
+    {
+        Ticket               ticket = 0;
+        JobKind              kind   = JobKind::jk_buffer;
+        std::string          path;
+        tex::ImageData       image;
+        bool                 keep_image = false;
+        GLenum               target     = 0;
+        GLenum               usage      = 0;
+        std::vector<uint8_t> data;
+    };
+
+    struct Done
+    {
+        Loaded result;
+        GLsync fence = nullptr;
+    };
+
+    GLFWwindow *            mp_context_win;
+    bool                    m_has_sync;
+    Ticket                  m_next_ticket;
+    std::thread             m_thread;
+    std::mutex              m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Job>         m_jobs;
+    std::deque<Done>        m_done;
+    bool                    m_stop;
+
+    Ticket push(Job && job);
+    void   loaderLoop();
+    void   process(Job & job, Done & done);
+
+public:
+    AsyncLoader();
+    ~AsyncLoader();
+
+    AsyncLoader(const AsyncLoader &) = delete;
+    AsyncLoader & operator=(const AsyncLoader &) = delete;
+
+    // main thread: GLFW windows can only be created and destroyed there
+    void start(GLFWwindow * share);
+    void stop();
+
+    bool isRunning() const { return mp_context_win != nullptr; }
+
+    Ticket loadTexture(std::string const & path, bool keep_image = false);
+    Ticket uploadTexture(tex::ImageData && image);
+    Ticket uploadBuffer(GLenum target, std::vector<uint8_t> && data, GLenum usage = GL_STATIC_DRAW);
+
+    // render thread: moves out the finished uploads whose fences have signaled, never waits
+    void poll(std::vector<Loaded> & finished);
+};
+
+// Headless check of the whole path: creates a hidden window, loads file_name through an
+// AsyncLoader, polls until its fence has signaled and compares the texture read back with
+// glGetTexImage against the decoded image. Runs under Xvfb with Mesa llvmpipe.
+bool AsyncLoaderTest(std::string const & file_name);
+
+#endif   // ASYNCLOADER_H
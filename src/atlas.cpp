@@ -0,0 +1,412 @@
+#include "atlas.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+constexpr char     atlas_magic[4] = {'A', 'T', 'L', '1'};
+constexpr uint32_t atlas_version  = 1;
+// largest side written or accepted, keeps width * height * bpp far from wrapping
+constexpr uint32_t max_atlas_size = 16384;
+
+// pixels follow the region table; a region record is the name length, the name and
+// x, y, width, height as uint32, the uvs are recomputed on load
+struct AtlasHeader
+{
+    char     magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pixel_type;
+    uint32_t region_count;
+};
+
+static_assert(sizeof(AtlasHeader) == 24, "AtlasHeader layout is part of the file format");
+
+struct SkylineNode
+{
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+};
+
+struct Cell
+{
+    uint32_t index;
+    uint32_t width;
+    uint32_t height;
+    uint32_t x = 0;
+    uint32_t y = 0;
+};
+
+uint32_t AlignUp(uint32_t value, uint32_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+uint32_t NextPowerOfTwo(uint32_t value)
+{
+    uint32_t p = 1;
+    while(p < value)
+        p <<= 1;
+
+    return p;
+}
+
+uint32_t BytesPerPixel(tex::ImageData::PixelType type)
+{
+    return type == tex::ImageData::PixelType::pt_rgb ? 3 : 4;
+}
+
+// Bottom-left rule: the lowest top edge wins, ties go to the narrower skyline segment
+bool FindPosition(std::vector<SkylineNode> const & skyline, uint32_t width, uint32_t height, uint32_t atlas_width,
+                  uint32_t atlas_height, size_t & best_node, uint32_t & best_x, uint32_t & best_y)
+{
+    uint32_t best_top   = UINT32_MAX;
+    uint32_t best_width = UINT32_MAX;
+
+    for(size_t i = 0; i < skyline.size(); ++i)
+    {
+        uint32_t x = skyline[i].x;
+        if(x + width > atlas_width)
+            break;
+
+        // the cell rests on the highest segment it spans
+        uint32_t y       = 0;
+        uint32_t covered = 0;
+        for(size_t j = i; covered < width; ++j)
+        {
+            y = std::max(y, skyline[j].y);
+            covered += skyline[j].width;
+        }
+
+        if(y + height > atlas_height)
+            continue;
+
+        if(y + height < best_top || (y + height == best_top && skyline[i].width < best_width))
+        {
+            best_top   = y + height;
+            best_width = skyline[i].width;
+            best_node  = i;
+            best_x     = x;
+            best_y     = y;
+        }
+    }
+
+    return best_top != UINT32_MAX;
+}
+
+void AddSkylineLevel(std::vector<SkylineNode> & skyline, size_t node, uint32_t x, uint32_t y, uint32_t width,
+                     uint32_t height)
+{
+    skyline.insert(skyline.begin() + static_cast<std::ptrdiff_t>(node), SkylineNode{x, y + height, width});
+
+    // trim or drop the segments the new one now covers
+    for(size_t i = node + 1; i < skyline.size();)
+    {
+        SkylineNode const & prev = skyline[i - 1];
+        uint32_t const      end  = prev.x + prev.width;
+        if(skyline[i].x >= end)
+            break;
+
+        uint32_t shrink = end - skyline[i].x;
+        if(skyline[i].width <= shrink)
+        {
+            skyline.erase(skyline.begin() + static_cast<std::ptrdiff_t>(i));
+            continue;
+        }
+
+        skyline[i].x += shrink;
+        skyline[i].width -= shrink;
+        break;
+    }
+
+    for(size_t i = 0; i + 1 < skyline.size();)
+    {
+        if(skyline[i].y == skyline[i + 1].y)
+        {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + static_cast<std::ptrdiff_t>(i + 1));
+        }
+        else
+            ++i;
+    }
+}
+
+bool PackCells(std::vector<Cell> & cells, uint32_t atlas_width, uint32_t atlas_height)
+{
+    std::vector<SkylineNode> skyline{SkylineNode{0, 0, atlas_width}};
+
+    for(auto & c : cells)
+    {
+        size_t   node = 0;
+        uint32_t x = 0, y = 0;
+        if(!FindPosition(skyline, c.width, c.height, atlas_width, atlas_height, node, x, y))
+            return false;
+
+        AddSkylineLevel(skyline, node, x, y, c.width, c.height);
+        c.x = x;
+        c.y = y;
+    }
+
+    return true;
+}
+
+void CopyImage(tex::ImageData const & src, tex::ImageData & dst, uint32_t dst_x, uint32_t dst_y)
+{
+    uint32_t const src_bpp = BytesPerPixel(src.type);
+    uint32_t const dst_bpp = BytesPerPixel(dst.type);
+
+    for(uint32_t y = 0; y < src.height; ++y)
+    {
+        uint8_t const * s = src.data.get() + static_cast<size_t>(y) * src.width * src_bpp;
+        uint8_t *       d = dst.data.get() + (static_cast<size_t>(dst_y + y) * dst.width + dst_x) * dst_bpp;
+
+        if(src_bpp == dst_bpp)
+        {
+            std::memcpy(d, s, static_cast<size_t>(src.width) * src_bpp);
+            continue;
+        }
+
+        for(uint32_t x = 0; x < src.width; ++x, s += src_bpp, d += dst_bpp)
+        {
+            d[0] = s[0];
+            d[1] = s[1];
+            d[2] = s[2];
+            d[3] = 255;
+        }
+    }
+}
+
+// Repeats the border texels of the placed image outwards, so bilinear taps and the lower
+// mip levels at the region edge sample the image itself instead of a neighbour
+void ExtrudeEdges(tex::ImageData & dst, tex::AtlasRegion const & r, uint32_t gutter)
+{
+    uint32_t const bpp   = BytesPerPixel(dst.type);
+    size_t const   pitch = static_cast<size_t>(dst.width) * bpp;
+    uint8_t *      base  = dst.data.get();
+
+    for(uint32_t y = r.y; y < r.y + r.height; ++y)
+    {
+        uint8_t * row   = base + y * pitch;
+        uint8_t * left  = row + static_cast<size_t>(r.x) * bpp;
+        uint8_t * right = row + static_cast<size_t>(r.x + r.width - 1) * bpp;
+        for(uint32_t g = 1; g <= gutter; ++g)
+        {
+            std::memcpy(left - g * bpp, left, bpp);
+            std::memcpy(right + g * bpp, right, bpp);
+        }
+    }
+
+    // whole rows including the side gutters just filled, which also covers the corners
+    size_t const    span   = static_cast<size_t>(r.width + 2 * gutter) * bpp;
+    size_t const    offset = static_cast<size_t>(r.x - gutter) * bpp;
+    uint8_t const * bottom = base + r.y * pitch + offset;
+    uint8_t const * top    = base + (r.y + r.height - 1) * pitch + offset;
+    for(uint32_t g = 1; g <= gutter; ++g)
+    {
+        std::memcpy(base + (r.y - g) * pitch + offset, bottom, span);
+        std::memcpy(base + (r.y + r.height - 1 + g) * pitch + offset, top, span);
+    }
+}
+
+void ComputeUV(tex::AtlasRegion & r, uint32_t atlas_width, uint32_t atlas_height)
+{
+    float const inv_w = 1.0f / static_cast<float>(atlas_width);
+    float const inv_h = 1.0f / static_cast<float>(atlas_height);
+
+    r.u0 = static_cast<float>(r.x) * inv_w;
+    r.v0 = static_cast<float>(r.y) * inv_h;
+    r.u1 = static_cast<float>(r.x + r.width) * inv_w;
+    r.v1 = static_cast<float>(r.y + r.height) * inv_h;
+}
+}   // namespace
+
+namespace tex
+{
+bool BuildAtlas(std::vector<AtlasInput> const & inputs, AtlasOptions const & opt, Atlas & atlas)
+{
+    uint32_t const alignment = std::max(opt.alignment, 1u);
+    if((alignment & (alignment - 1)) != 0 || inputs.empty())
+        return false;
+
+    ImageData::PixelType type = ImageData::PixelType::pt_rgb;
+    std::vector<Cell>    cells;
+    cells.reserve(inputs.size());
+
+    uint64_t area     = 0;
+    uint32_t max_side = 1;
+    for(size_t i = 0; i < inputs.size(); ++i)
+    {
+        ImageData const * img = inputs[i].image;
+        if(img == nullptr || !img->data || img->width == 0 || img->height == 0
+           || img->type == ImageData::PixelType::pt_none)
+            return false;
+
+        if(img->width > opt.max_size || img->height > opt.max_size)
+            return false;
+
+        if(img->type == ImageData::PixelType::pt_rgba)
+            type = ImageData::PixelType::pt_rgba;
+
+        Cell c{static_cast<uint32_t>(i), AlignUp(img->width + 2 * opt.gutter + opt.padding, alignment),
+               AlignUp(img->height + 2 * opt.gutter + opt.padding, alignment)};
+        area += static_cast<uint64_t>(c.width) * c.height;
+        max_side = std::max({max_side, c.width, c.height});
+        cells.push_back(c);
+    }
+
+    // tallest first keeps the skyline flat
+    std::sort(cells.begin(), cells.end(), [](Cell const & a, Cell const & b) {
+        return a.height != b.height ? a.height > b.height : a.width > b.width;
+    });
+
+    uint32_t side = NextPowerOfTwo(std::max(max_side, alignment));
+    while(static_cast<uint64_t>(side) * side < area)
+        side <<= 1;
+
+    uint32_t const max_size = std::min(opt.max_size, max_atlas_size);
+    if(side > max_size)
+        return false;
+
+    // side x side, then 2*side x side before doubling both
+    uint32_t width = side, height = side;
+    while(!PackCells(cells, width, height))
+    {
+        if(width == height)
+            width <<= 1;
+        else
+            height = width;
+
+        if(width > max_size)
+            return false;
+    }
+
+    ImageData & img = atlas.image;
+    img.width       = width;
+    img.height      = height;
+    img.type        = type;
+    img.data        = std::make_unique<uint8_t[]>(static_cast<size_t>(width) * height * BytesPerPixel(type));
+
+    atlas.regions.assign(inputs.size(), AtlasRegion{});
+    for(auto const & c : cells)
+    {
+        ImageData const & src = *inputs[c.index].image;
+        AtlasRegion &     r   = atlas.regions[c.index];
+
+        r.name   = inputs[c.index].name;
+        r.x      = c.x + opt.gutter;
+        r.y      = c.y + opt.gutter;
+        r.width  = src.width;
+        r.height = src.height;
+        ComputeUV(r, width, height);
+
+        CopyImage(src, img, r.x, r.y);
+        if(opt.gutter > 0)
+            ExtrudeEdges(img, r, opt.gutter);
+    }
+
+    return true;
+}
+
+bool WriteAtlas(std::string const & file_name, Atlas const & atlas)
+{
+    ImageData const & img = atlas.image;
+    if(!img.data || img.type == ImageData::PixelType::pt_none)
+        return false;
+
+    std::ofstream ofile(file_name, std::ios::binary);
+    if(!ofile.is_open())
+        return false;
+
+    AtlasHeader h;
+    std::memcpy(h.magic, atlas_magic, sizeof(h.magic));
+    h.version      = atlas_version;
+    h.width        = img.width;
+    h.height       = img.height;
+    h.pixel_type   = static_cast<uint32_t>(img.type);
+    h.region_count = static_cast<uint32_t>(atlas.regions.size());
+    ofile.write(reinterpret_cast<char const *>(&h), sizeof(h));
+
+    for(auto const & r : atlas.regions)
+    {
+        uint32_t record[5] = {static_cast<uint32_t>(r.name.size()), r.x, r.y, r.width, r.height};
+        ofile.write(reinterpret_cast<char const *>(&record[0]), sizeof(uint32_t));
+        ofile.write(r.name.data(), static_cast<std::streamsize>(r.name.size()));
+        ofile.write(reinterpret_cast<char const *>(&record[1]), 4 * sizeof(uint32_t));
+    }
+
+    ofile.write(reinterpret_cast<char const *>(img.data.get()),
+                static_cast<std::streamsize>(static_cast<size_t>(img.width) * img.height * BytesPerPixel(img.type)));
+    ofile.close();
+
+    return !ofile.fail();
+}
+
+bool ReadAtlas(std::string const & file_name, Atlas & atlas)
+{
+    std::ifstream ifile(file_name, std::ios::binary);
+    if(!ifile.is_open())
+        return false;
+
+    ifile.seekg(0, std::ios_base::end);
+    auto const length = static_cast<uint64_t>(ifile.tellg());
+    ifile.seekg(0, std::ios_base::beg);
+
+    AtlasHeader h;
+    ifile.read(reinterpret_cast<char *>(&h), sizeof(h));
+    if(ifile.fail() || std::memcmp(h.magic, atlas_magic, sizeof(atlas_magic)) != 0 || h.version != atlas_version
+       || h.width == 0 || h.height == 0 || h.width > max_atlas_size || h.height > max_atlas_size
+       || h.pixel_type > static_cast<uint32_t>(ImageData::PixelType::pt_rgba))
+        return false;
+
+    auto const     type       = static_cast<ImageData::PixelType>(h.pixel_type);
+    uint64_t const pixel_size = static_cast<uint64_t>(h.width) * h.height * BytesPerPixel(type);
+
+    // every size below comes from the file, nothing is allocated before it is known to fit
+    uint64_t remaining = length - sizeof(h);
+    if(pixel_size > remaining || h.region_count > (remaining - pixel_size) / (5 * sizeof(uint32_t)))
+        return false;
+    remaining -= pixel_size;
+
+    std::vector<AtlasRegion> regions(h.region_count);
+    for(auto & r : regions)
+    {
+        uint32_t name_length = 0;
+        ifile.read(reinterpret_cast<char *>(&name_length), sizeof(name_length));
+        if(ifile.fail() || remaining < 5 * sizeof(uint32_t) + static_cast<uint64_t>(name_length))
+            return false;
+        remaining -= 5 * sizeof(uint32_t) + name_length;
+
+        uint32_t rect[4];
+        r.name.resize(name_length);
+        ifile.read(&r.name[0], name_length);
+        ifile.read(reinterpret_cast<char *>(rect), sizeof(rect));
+        if(ifile.fail())
+            return false;
+
+        r.x      = rect[0];
+        r.y      = rect[1];
+        r.width  = rect[2];
+        r.height = rect[3];
+        if(r.x > h.width || r.width > h.width - r.x || r.y > h.height || r.height > h.height - r.y)
+            return false;
+
+        ComputeUV(r, h.width, h.height);
+    }
+
+    auto data = std::make_unique<uint8_t[]>(static_cast<size_t>(pixel_size));
+    ifile.read(reinterpret_cast<char *>(data.get()), static_cast<std::streamsize>(pixel_size));
+    if(ifile.fail())
+        return false;
+
+    atlas.image.width  = h.width;
+    atlas.image.height = h.height;
+    atlas.image.type   = type;
+    atlas.image.data   = std::move(data);
+    atlas.regions      = std::move(regions);
+
+    return true;
+}
+}   // namespace tex
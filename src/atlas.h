@@ -0,0 +1,61 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "imagedata.h"
+
+namespace tex
+{
+struct AtlasInput
+{
+    std::string       name;
+    ImageData const * image = nullptr;
+};
+
+// Where an input ended up. x, y, width, height is the image itself, without the gutter;
+// the uv rectangle covers exactly those texels (v grows upwards like ImageData rows).
+struct AtlasRegion
+{
+    std::string name;
+    uint32_t    x      = 0;
+    uint32_t    y      = 0;
+    uint32_t    width  = 0;
+    uint32_t    height = 0;
+    float       u0 = 0.0f, v0 = 0.0f, u1 = 0.0f, v1 = 0.0f;
+
+    // maps a uv of the source image into the atlas
+    void remap(float & u, float & v) const
+    {
+        u = u0 + u * (u1 - u0);
+        v = v0 + v * (v1 - v0);
+    }
+};
+
+struct AtlasOptions
+{
+    uint32_t max_size = 4096;   // at most 16384
+    uint32_t gutter   = 2;   // edge texels repeated around each image against filtering bleed
+    uint32_t padding  = 0;   // empty texels between neighbouring gutters
+    // cells start and end on multiples of this, so the first log2(alignment) mip levels
+    // never mix texels of two images in one block
+    uint32_t alignment = 4;
+};
+
+struct Atlas
+{
+    ImageData                image;
+    std::vector<AtlasRegion> regions;   // in input order
+};
+
+// Skyline bottom-left packing into the smallest power-of-two square or 2:1 texture that
+// fits. Inputs are stored as RGBA if any of them has alpha, otherwise as RGB.
+bool BuildAtlas(std::vector<AtlasInput> const & inputs, AtlasOptions const & opt, Atlas & atlas);
+
+// Cooked atlas: header, region table and raw pixels, loaded without any repacking
+bool WriteAtlas(std::string const & file_name, Atlas const & atlas);
+bool ReadAtlas(std::string const & file_name, Atlas & atlas);
+}   // namespace tex
+#endif   // ATLAS_H
@@ -0,0 +1,577 @@
+#include "culling.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64)
+#    include <immintrin.h>
+#endif
+
+namespace
+{
+constexpr uint32_t all_planes = 0x3F;
+
+using Clock = std::chrono::steady_clock;
+
+double ElapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+}   // namespace
+
+namespace cull
+{
+Frustum ExtractFrustum(glm::mat4 const & view_proj)
+{
+    // glm is column-major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    auto row = [&view_proj](int i) {
+        return glm::vec4(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]);
+    };
+
+    glm::vec4 const r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+    glm::vec4 const planes[6] = {r3 + r0, r3 - r0, r3 + r1, r3 - r1, r3 + r2, r3 - r2};
+
+    Frustum f;
+    for(int p = 0; p < 6; ++p)
+    {
+        float len = std::sqrt(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+        for(int c = 0; c < 4; ++c)
+            f.planes[p][c] = planes[p][c] / len;
+    }
+
+    return f;
+}
+
+void CullBoxes(Frustum const & f, uint32_t plane_mask, float const * cx, float const * cy, float const * cz,
+               float const * ex, float const * ey, float const * ez, uint32_t const * ids, uint32_t count,
+               std::vector<uint32_t> & visible)
+{
+    // a box is outside a plane if dot(n, c) + w < -dot(|n|, e)
+    int   active[6];
+    int   num_active = 0;
+    float abs_n[6][3];
+    for(int p = 0; p < 6; ++p)
+    {
+        if(plane_mask & (1u << p))
+            active[num_active++] = p;
+        for(int c = 0; c < 3; ++c)
+            abs_n[p][c] = std::fabs(f.planes[p][c]);
+    }
+
+    uint32_t i = 0;
+
+#if defined(__SSE__) || defined(_M_X64)
+    __m128 const zero4 = _mm_setzero_ps();
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(cx + i), y = _mm_loadu_ps(cy + i), z = _mm_loadu_ps(cz + i);
+        __m128 hx = _mm_loadu_ps(ex + i), hy = _mm_loadu_ps(ey + i), hz = _mm_loadu_ps(ez + i);
+        __m128 outside = zero4;
+        for(int a = 0; a < num_active; ++a)
+        {
+            float const * pl = f.planes[active[a]];
+            float const * an = abs_n[active[a]];
+
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(pl[0]), x), _mm_mul_ps(_mm_set1_ps(pl[1]), y)),
+                                  _mm_add_ps(_mm_mul_ps(_mm_set1_ps(pl[2]), z), _mm_set1_ps(pl[3])));
+            __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(an[0]), hx), _mm_mul_ps(_mm_set1_ps(an[1]), hy)),
+                                  _mm_mul_ps(_mm_set1_ps(an[2]), hz));
+            outside  = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, r), zero4));
+        }
+
+        int m = _mm_movemask_ps(outside);
+        if(m == 0xF)
+            continue;
+        for(uint32_t k = 0; k < 4; ++k)
+        {
+            if(!(m & (1 << k)))
+                visible.push_back(ids[i + k]);
+        }
+    }
+#endif
+
+    for(; i < count; ++i)
+    {
+        bool outside = false;
+        for(int a = 0; a < num_active && !outside; ++a)
+        {
+            float const * pl = f.planes[active[a]];
+            float const * an = abs_n[active[a]];
+
+            float d = pl[0] * cx[i] + pl[1] * cy[i] + pl[2] * cz[i] + pl[3];
+            float r = an[0] * ex[i] + an[1] * ey[i] + an[2] * ez[i];
+            outside = d + r < 0.0f;
+        }
+
+        if(!outside)
+            visible.push_back(ids[i]);
+    }
+}
+
+//==============================================================================
+//         WorkerPool
+//==============================================================================
+WorkerPool::WorkerPool(uint32_t num_threads) : mp_job{nullptr}, m_generation{0}, m_running{0}, m_stop{false}
+{
+    for(uint32_t i = 1; i < num_threads; ++i)
+        m_threads.emplace_back(&WorkerPool::workerLoop, this, i);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_start_cv.notify_all();
+
+    for(auto & t : m_threads)
+        t.join();
+}
+
+void WorkerPool::workerLoop(uint32_t index)
+{
+    uint64_t seen = 0;
+    for(;;)
+    {
+        std::function<void(uint32_t)> const * job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start_cv.wait(lock, [&] { return m_stop || m_generation != seen; });
+            if(m_stop)
+                return;
+
+            seen = m_generation;
+            job  = mp_job;
+        }
+
+        (*job)(index);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(--m_running == 0)
+            m_done_cv.notify_one();
+    }
+}
+
+void WorkerPool::run(std::function<void(uint32_t)> const & job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        mp_job    = &job;
+        m_running = static_cast<uint32_t>(m_threads.size());
+        ++m_generation;
+    }
+    m_start_cv.notify_all();
+
+    job(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_cv.wait(lock, [this] { return m_running == 0; });
+}
+
+//==============================================================================
+//         Bvh
+//==============================================================================
+Bvh::Bvh() : m_dirty{false} {}
+
+void Bvh::build(std::vector<AABB> const & boxes)
+{
+    auto count = static_cast<uint32_t>(boxes.size());
+
+    m_order.resize(count);
+    std::iota(m_order.begin(), m_order.end(), 0u);
+    m_nodes.clear();
+
+    if(count > 0)
+    {
+        m_nodes.reserve(2 * (count / max_leaf_size + 1));
+        m_nodes.emplace_back();
+        m_nodes[0].first = 0;
+        m_nodes[0].count = count;
+        buildNode(0, boxes);
+    }
+
+    m_slot.resize(count);
+    for(auto * v : {&m_cx, &m_cy, &m_cz, &m_ex, &m_ey, &m_ez})
+        v->resize(count);
+
+    for(uint32_t pos = 0; pos < count; ++pos)
+    {
+        auto const & b = boxes[m_order[pos]];
+
+        m_slot[m_order[pos]] = pos;
+        m_cx[pos]            = (b.min.x + b.max.x) * 0.5f;
+        m_cy[pos]            = (b.min.y + b.max.y) * 0.5f;
+        m_cz[pos]            = (b.min.z + b.max.z) * 0.5f;
+        m_ex[pos]            = (b.max.x - b.min.x) * 0.5f;
+        m_ey[pos]            = (b.max.y - b.min.y) * 0.5f;
+        m_ez[pos]            = (b.max.z - b.min.z) * 0.5f;
+    }
+
+    m_dirty = false;
+}
+
+void Bvh::buildNode(uint32_t node, std::vector<AABB> const & boxes)
+{
+    uint32_t const first = m_nodes[node].first;
+    uint32_t const count = m_nodes[node].count;
+
+    glm::vec3 lo = boxes[m_order[first]].min, hi = boxes[m_order[first]].max;
+    glm::vec3 clo = (lo + hi) * 0.5f, chi = clo;
+    for(uint32_t i = first; i < first + count; ++i)
+    {
+        auto const & b = boxes[m_order[i]];
+        glm::vec3    c = (b.min + b.max) * 0.5f;
+
+        lo  = glm::min(lo, b.min);
+        hi  = glm::max(hi, b.max);
+        clo = glm::min(clo, c);
+        chi = glm::max(chi, c);
+    }
+
+    m_nodes[node].min = lo;
+    m_nodes[node].max = hi;
+
+    if(count <= max_leaf_size)
+        return;
+
+    // median split along the longest axis of the centroid bounds
+    glm::vec3 extent = chi - clo;
+    int       axis   = 0;
+    if(extent[1] > extent[axis])
+        axis = 1;
+    if(extent[2] > extent[axis])
+        axis = 2;
+
+    uint32_t const half = count / 2;
+    std::nth_element(m_order.begin() + first, m_order.begin() + first + half, m_order.begin() + first + count,
+                     [&boxes, axis](uint32_t a, uint32_t b) {
+                         return boxes[a].min[axis] + boxes[a].max[axis] < boxes[b].min[axis] + boxes[b].max[axis];
+                     });
+
+    auto left          = static_cast<uint32_t>(m_nodes.size());
+    m_nodes[node].left = left;
+    m_nodes.emplace_back();
+    m_nodes.emplace_back();
+    m_nodes[left].first     = first;
+    m_nodes[left].count     = half;
+    m_nodes[left + 1].first = first + half;
+    m_nodes[left + 1].count = count - half;
+
+    buildNode(left, boxes);
+    buildNode(left + 1, boxes);
+}
+
+void Bvh::update(uint32_t object, AABB const & box)
+{
+    uint32_t pos = m_slot[object];
+
+    m_cx[pos] = (box.min.x + box.max.x) * 0.5f;
+    m_cy[pos] = (box.min.y + box.max.y) * 0.5f;
+    m_cz[pos] = (box.min.z + box.max.z) * 0.5f;
+    m_ex[pos] = (box.max.x - box.min.x) * 0.5f;
+    m_ey[pos] = (box.max.y - box.min.y) * 0.5f;
+    m_ez[pos] = (box.max.z - box.min.z) * 0.5f;
+    m_dirty   = true;
+}
+
+void Bvh::refit()
+{
+    if(!m_dirty)
+        return;
+
+    // children are always stored after their parent
+    for(size_t n = m_nodes.size(); n-- > 0;)
+    {
+        Node & node = m_nodes[n];
+        if(node.left != 0)
+        {
+            node.min = glm::min(m_nodes[node.left].min, m_nodes[node.left + 1].min);
+            node.max = glm::max(m_nodes[node.left].max, m_nodes[node.left + 1].max);
+            continue;
+        }
+
+        glm::vec3 lo{std::numeric_limits<float>::max()}, hi{-std::numeric_limits<float>::max()};
+        for(uint32_t i = node.first; i < node.first + node.count; ++i)
+        {
+            glm::vec3 c{m_cx[i], m_cy[i], m_cz[i]}, e{m_ex[i], m_ey[i], m_ez[i]};
+            lo = glm::min(lo, c - e);
+            hi = glm::max(hi, c + e);
+        }
+        node.min = lo;
+        node.max = hi;
+    }
+
+    m_dirty = false;
+}
+
+bool Bvh::testNode(Frustum const & f, Node const & node, uint32_t & plane_mask) const
+{
+    glm::vec3 c = (node.min + node.max) * 0.5f, e = (node.max - node.min) * 0.5f;
+
+    for(uint32_t p = 0; p < 6; ++p)
+    {
+        if(!(plane_mask & (1u << p)))
+            continue;
+
+        float const * pl = f.planes[p];
+        float         d  = pl[0] * c.x + pl[1] * c.y + pl[2] * c.z + pl[3];
+        float         r  = std::fabs(pl[0]) * e.x + std::fabs(pl[1]) * e.y + std::fabs(pl[2]) * e.z;
+
+        if(d + r < 0.0f)
+            return false;
+        if(d - r >= 0.0f)   // completely inside, the subtree doesn't need this plane
+            plane_mask &= ~(1u << p);
+    }
+
+    return true;
+}
+
+void Bvh::traverse(Frustum const & f, uint32_t node_index, uint32_t plane_mask, std::vector<uint32_t> & out,
+                   CullStats & st) const
+{
+    Node const & node = m_nodes[node_index];
+
+    ++st.nodes_tested;
+    if(!testNode(f, node, plane_mask))
+        return;
+
+    if(plane_mask == 0)
+    {
+        out.insert(out.end(), m_order.begin() + node.first, m_order.begin() + node.first + node.count);
+        return;
+    }
+
+    if(node.left == 0)
+    {
+        st.objects_tested += node.count;
+        CullBoxes(f, plane_mask, &m_cx[node.first], &m_cy[node.first], &m_cz[node.first], &m_ex[node.first],
+                  &m_ey[node.first], &m_ez[node.first], &m_order[node.first], node.count, out);
+        return;
+    }
+
+    traverse(f, node.left, plane_mask, out, st);
+    traverse(f, node.left + 1, plane_mask, out, st);
+}
+
+CullStats Bvh::cull(Frustum const & f, std::vector<uint32_t> & visible, Threading threading) const
+{
+    CullStats st;
+    auto      start = Clock::now();
+    size_t    base  = visible.size();
+
+    uint32_t num_threads = mp_pool ? mp_pool->size() : std::thread::hardware_concurrency();
+    if(m_nodes.empty())
+    {
+        // nothing to do
+    }
+    else if(threading == Threading::th_serial || (threading == Threading::th_auto && objectCount() < parallel_threshold)
+            || num_threads < 2)
+    {
+        traverse(f, 0, all_planes, visible, st);
+    }
+    else
+    {
+        if(!mp_pool)
+            mp_pool = std::make_unique<WorkerPool>(num_threads);
+
+        // open the top of the tree breadth-first until there are a few subtrees per thread
+        struct Task
+        {
+            uint32_t node;
+            uint32_t plane_mask;
+        };
+
+        std::vector<Task> tasks{{0, all_planes}}, next;
+        bool              expanded = true;
+        while(expanded && tasks.size() < num_threads * 4)
+        {
+            expanded = false;
+            next.clear();
+            for(auto const & t : tasks)
+            {
+                Node const & node = m_nodes[t.node];
+                if(node.left == 0)
+                {
+                    next.push_back(t);
+                    continue;
+                }
+
+                uint32_t mask = t.plane_mask;
+                ++st.nodes_tested;
+                if(!testNode(f, node, mask))
+                    continue;
+
+                next.push_back({node.left, mask});
+                next.push_back({node.left + 1, mask});
+                expanded = true;
+            }
+            tasks.swap(next);
+        }
+
+        std::vector<std::vector<uint32_t>> results(tasks.size());
+        std::vector<CullStats>             worker_stats(num_threads);
+        std::atomic<uint32_t>              next_task{0};
+
+        std::function<void(uint32_t)> const worker = [&](uint32_t w) {
+            for(uint32_t t = next_task++; t < tasks.size(); t = next_task++)
+                traverse(f, tasks[t].node, tasks[t].plane_mask, results[t], worker_stats[w]);
+        };
+
+        mp_pool->run(worker);
+
+        // concatenating in task order keeps the output in leaf order
+        for(auto const & r : results)
+            visible.insert(visible.end(), r.begin(), r.end());
+        for(auto const & ws : worker_stats)
+        {
+            st.nodes_tested += ws.nodes_tested;
+            st.objects_tested += ws.objects_tested;
+        }
+    }
+
+    st.visible = static_cast<uint32_t>(visible.size() - base);
+    st.culled  = objectCount() - st.visible;
+    st.ms      = ElapsedMs(start);
+
+    return st;
+}
+
+//==============================================================================
+//         Benchmark
+//==============================================================================
+void Benchmark(glm::mat4 const & view_proj, uint32_t object_count, uint32_t iterations)
+{
+    if(object_count == 0 || iterations == 0)
+        return;
+
+    std::mt19937                          rng{1234};
+    std::uniform_real_distribution<float> pos{-50.0f, 50.0f}, size{0.1f, 1.0f}, step{-0.5f, 0.5f};
+
+    std::vector<AABB> boxes(object_count);
+    for(auto & b : boxes)
+    {
+        glm::vec3 c{pos(rng), pos(rng), pos(rng)}, e{size(rng), size(rng), size(rng)};
+        b = AABB{c - e, c + e};
+    }
+
+    // brute force input in SoA form
+    std::vector<float>    cx(object_count), cy(object_count), cz(object_count);
+    std::vector<float>    ex(object_count), ey(object_count), ez(object_count);
+    std::vector<uint32_t> ids(object_count);
+    for(uint32_t i = 0; i < object_count; ++i)
+    {
+        cx[i]  = (boxes[i].min.x + boxes[i].max.x) * 0.5f;
+        cy[i]  = (boxes[i].min.y + boxes[i].max.y) * 0.5f;
+        cz[i]  = (boxes[i].min.z + boxes[i].max.z) * 0.5f;
+        ex[i]  = (boxes[i].max.x - boxes[i].min.x) * 0.5f;
+        ey[i]  = (boxes[i].max.y - boxes[i].min.y) * 0.5f;
+        ez[i]  = (boxes[i].max.z - boxes[i].min.z) * 0.5f;
+        ids[i] = i;
+    }
+
+    Frustum const f = ExtractFrustum(view_proj);
+
+    Bvh  bvh;
+    auto start = Clock::now();
+    bvh.build(boxes);
+    double build_ms = ElapsedMs(start);
+
+    std::vector<uint32_t> visible;
+    visible.reserve(object_count);
+
+    auto report = [object_count](char const * name, double ms, size_t num_visible) {
+        double culled = static_cast<double>(object_count - num_visible);
+        std::cout << std::setw(14) << name << ": " << std::fixed << std::setprecision(3) << ms << " ms, "
+                  << std::setprecision(0) << culled / ms << " objects culled/ms, " << object_count / ms
+                  << " objects/ms" << std::endl;
+    };
+
+    // the parallel rows force the worker pool; with a single hardware thread they run serially
+    uint32_t num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    std::cout << "Culling " << object_count << " objects, " << iterations << " iterations, " << num_threads
+              << " threads, BVH build " << std::setprecision(3) << std::fixed << build_ms << " ms" << std::endl;
+
+    start = Clock::now();
+    for(uint32_t it = 0; it < iterations; ++it)
+    {
+        visible.clear();
+        CullBoxes(f, all_planes, cx.data(), cy.data(), cz.data(), ex.data(), ey.data(), ez.data(), ids.data(),
+                  object_count, visible);
+    }
+    report("brute force", ElapsedMs(start) / iterations, visible.size());
+
+    start = Clock::now();
+    for(uint32_t it = 0; it < iterations; ++it)
+    {
+        visible.clear();
+        bvh.cull(f, visible, Bvh::Threading::th_serial);
+    }
+    report("bvh", ElapsedMs(start) / iterations, visible.size());
+
+    start = Clock::now();
+    for(uint32_t it = 0; it < iterations; ++it)
+    {
+        visible.clear();
+        bvh.cull(f, visible, Bvh::Threading::th_parallel);
+    }
+    report("bvh parallel", ElapsedMs(start) / iterations, visible.size());
+
+    // move a tenth of the objects every iteration
+    double refit_ms = 0.0;
+    start           = Clock::now();
+    for(uint32_t it = 0; it < iterations; ++it)
+    {
+        for(uint32_t i = it % 10; i < object_count; i += 10)
+        {
+            glm::vec3 d{step(rng), step(rng), step(rng)};
+            boxes[i] = AABB{boxes[i].min + d, boxes[i].max + d};
+            bvh.update(i, boxes[i]);
+        }
+
+        auto refit_start = Clock::now();
+        bvh.refit();
+        refit_ms += ElapsedMs(refit_start);
+
+        visible.clear();
+        bvh.cull(f, visible, Bvh::Threading::th_parallel);
+    }
+    report("refit + cull", ElapsedMs(start) / iterations, visible.size());
+    std::cout << std::setw(14) << "refit" << ": " << std::setprecision(3) << refit_ms / iterations << " ms"
+              << std::endl;
+
+    if(num_threads < 2)
+        return;
+
+    // Bvh::parallel_threshold belongs where the parallel column starts to win
+    auto time_cull = [&f, &visible, iterations](Bvh const & b, Bvh::Threading threading) {
+        b.cull(f, visible, threading);   // warm up, the first parallel cull starts the pool
+        auto start = Clock::now();
+        for(uint32_t it = 0; it < iterations; ++it)
+        {
+            visible.clear();
+            b.cull(f, visible, threading);
+        }
+        return ElapsedMs(start) / iterations;
+    };
+
+    std::cout << "Crossover, serial / parallel BVH:" << std::endl;
+    for(uint32_t n = 1024; n != 0 && n <= object_count; n *= 2)
+    {
+        Bvh subset;
+        subset.build(std::vector<AABB>(boxes.begin(), boxes.begin() + n));
+
+        double serial_ms   = time_cull(subset, Bvh::Threading::th_serial);
+        double parallel_ms = time_cull(subset, Bvh::Threading::th_parallel);
+        std::cout << std::setw(14) << n << ": " << std::setprecision(4) << serial_ms << " / " << parallel_ms << " ms"
+                  << (parallel_ms < serial_ms ? ", parallel wins" : "") << std::endl;
+    }
+}
+}   // namespace cull
@@ -0,0 +1,139 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Include GLM
+#include <glm/glm.hpp>
+
+namespace cull
+{
+struct AABB
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// plane i: dot(n, p) + w >= 0 inside, normalized; order left, right, bottom, top, near, far
+struct Frustum
+{
+    float planes[6][4];
+};
+
+struct CullStats
+{
+    uint32_t nodes_tested   = 0;
+    uint32_t objects_tested = 0;
+    uint32_t visible        = 0;
+    uint32_t culled         = 0;
+    double   ms             = 0.0;
+};
+
+// Gribb/Hartmann plane extraction from projection * view
+Frustum ExtractFrustum(glm::mat4 const & view_proj);
+
+// Tests count boxes given as SoA centers and half extents against the planes in plane_mask
+// and appends ids[i] of the ones not fully outside
+void CullBoxes(Frustum const & f, uint32_t plane_mask, float const * cx, float const * cy, float const * cz,
+               float const * ex, float const * ey, float const * ez, uint32_t const * ids, uint32_t count,
+               std::vector<uint32_t> & visible);
+
+// Threads kept alive between culls, starting and joining them every frame costs more than
+// a serial traversal. run() hands the job to every worker and the calling thread (index 0)
+// and returns once all of them have finished.
+class WorkerPool
+{
+    std::vector<std::thread>              m_threads;
+    std::mutex                            m_mutex;
+    std::condition_variable               m_start_cv;
+    std::condition_variable               m_done_cv;
+    std::function<void(uint32_t)> const * mp_job;
+    uint64_t                              m_generation;
+    uint32_t                              m_running;
+    bool                                  m_stop;
+
+    void workerLoop(uint32_t index);
+
+public:
+    explicit WorkerPool(uint32_t num_threads);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool & operator=(const WorkerPool &) = delete;
+
+    uint32_t size() const { return static_cast<uint32_t>(m_threads.size()) + 1; }
+    void     run(std::function<void(uint32_t)> const & job);
+};
+
+// Bounding-volume hierarchy over object AABBs. Object bounds are kept in leaf order as
+// structure-of-arrays (centers and half extents), so leaves are tested 4 objects at a time
+// with SSE. Nodes fully inside a plane drop it for their subtree; a subtree inside all
+// planes is accepted without further tests.
+class Bvh
+{
+public:
+    enum class Threading
+    {
+        th_serial,
+        th_auto,       // the worker pool above parallel_threshold objects
+        th_parallel    // the worker pool whenever there is more than one hardware thread
+    };
+
+private:
+    struct Node
+    {
+        glm::vec3 min;
+        glm::vec3 max;
+        uint32_t  first = 0;   // object range in leaf order, valid for inner nodes too
+        uint32_t  count = 0;
+        uint32_t  left  = 0;   // 0 for leaves, the right child is left + 1
+    };
+
+    std::vector<Node>     m_nodes;
+    std::vector<uint32_t> m_order;   // leaf position -> object id
+    std::vector<uint32_t> m_slot;    // object id -> leaf position
+    // leaf-ordered SoA bounds
+    std::vector<float> m_cx, m_cy, m_cz;
+    std::vector<float> m_ex, m_ey, m_ez;
+    bool               m_dirty;
+    // created by the first parallel cull
+    mutable std::unique_ptr<WorkerPool> mp_pool;
+
+    void buildNode(uint32_t node, std::vector<AABB> const & boxes);
+    bool testNode(Frustum const & f, Node const & node, uint32_t & plane_mask) const;
+    void traverse(Frustum const & f, uint32_t node, uint32_t plane_mask, std::vector<uint32_t> & out,
+                  CullStats & st) const;
+
+public:
+    static constexpr uint32_t max_leaf_size      = 16;
+    // objects, below it th_auto traverses serially. The parallel path costs 10-15 us more
+    // than the serial one, a serial cull of 32k objects 15-20 us with a tenth of them
+    // visible, so 4 threads start to win around here (see the crossover in Benchmark)
+    static constexpr uint32_t parallel_threshold = 32768;
+
+    Bvh();
+
+    void build(std::vector<AABB> const & boxes);
+    // moving objects only update their bounds; refit() fixes the node bounds bottom-up
+    // and must run before the next cull()
+    void update(uint32_t object, AABB const & box);
+    void refit();
+
+    // appends the visible object ids in leaf order
+    CullStats cull(Frustum const & f, std::vector<uint32_t> & visible, Threading threading = Threading::th_auto) const;
+
+    uint32_t objectCount() const { return static_cast<uint32_t>(m_order.size()); }
+};
+
+// Times brute force, BVH and parallel BVH culling of random boxes and prints objects culled
+// per millisecond, then the serial and parallel BVH times for growing subsets of the boxes
+// to find where the worker pool starts to pay off
+void Benchmark(glm::mat4 const & view_proj, uint32_t object_count, uint32_t iterations);
+}   // namespace cull
+#endif   // CULLING_H
@@ -0,0 +1,163 @@
+#include "filewatch.h"
+#include <algorithm>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#    include <sys/inotify.h>
+#    include <unistd.h>
+#endif
+
+namespace
+{
+void SplitPath(std::string const & path, std::string & dir, std::string & name)
+{
+    auto pos = path.find_last_of("/\\");
+    if(pos == std::string::npos)
+    {
+        dir  = ".";
+        name = path;
+    }
+    else
+    {
+        dir  = pos == 0 ? "/" : path.substr(0, pos);
+        name = path.substr(pos + 1);
+    }
+}
+
+void AddUnique(std::vector<std::string> & changed, std::string const & path)
+{
+    if(std::find(changed.begin(), changed.end(), path) == changed.end())
+        changed.push_back(path);
+}
+}   // namespace
+
+FileWatcher::FileWatcher(std::chrono::milliseconds poll_interval) :
+    m_inotify_fd{-1},
+    m_last_poll{Clock::now()},
+    m_poll_interval{poll_interval}
+{
+#ifdef __linux__
+    m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+    if(m_inotify_fd >= 0)
+        close(m_inotify_fd);
+#endif
+}
+
+bool FileWatcher::add(std::string const & path)
+{
+    Entry e;
+    e.path = path;
+
+    std::string dir;
+    SplitPath(path, dir, e.name);
+
+    // the first successful stat always reports a change, it only records the baseline
+    if(!statChanged(e))
+        return false;
+
+#ifdef __linux__
+    if(m_inotify_fd >= 0)
+    {
+        // a directory watched twice yields the same descriptor; if the watch can't be
+        // added (e.g. ENOSPC, the per-user watch limit) the entry is polled instead
+        e.wd = inotify_add_watch(m_inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    }
+#endif
+
+    m_entries.push_back(e);
+
+    return true;
+}
+
+bool FileWatcher::statChanged(Entry & e)
+{
+    struct stat st;
+    if(stat(e.path.c_str(), &st) != 0)
+        return false;
+
+    auto mtime = static_cast<int64_t>(st.st_mtime);
+    auto size  = static_cast<int64_t>(st.st_size);
+    if(mtime == e.mtime && size == e.size)
+        return false;
+
+    e.mtime = mtime;
+    e.size  = size;
+
+    return true;
+}
+
+void FileWatcher::poll(std::vector<std::string> & changed)
+{
+    if(usesInotify())
+        pollInotify(changed);
+
+    pollStat(changed);
+}
+
+void FileWatcher::pollStat(std::vector<std::string> & changed)
+{
+    auto now = Clock::now();
+    if(now - m_last_poll < m_poll_interval)
+        return;
+    m_last_poll = now;
+
+    // only the entries without an inotify watch
+    for(auto & e : m_entries)
+    {
+        if(e.wd < 0 && statChanged(e))
+            AddUnique(changed, e.path);
+    }
+}
+
+void FileWatcher::pollInotify(std::vector<std::string> & changed)
+{
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    bool overflow = false;
+
+    for(;;)
+    {
+        ssize_t len = read(m_inotify_fd, buffer, sizeof(buffer));
+        if(len <= 0)
+            break;   // EAGAIN: nothing more queued
+
+        for(char * ptr = buffer; ptr < buffer + len;)
+        {
+            auto * ev = reinterpret_cast<inotify_event *>(ptr);
+            ptr += sizeof(inotify_event) + ev->len;
+
+            if(ev->mask & IN_Q_OVERFLOW)
+            {
+                overflow = true;
+                continue;
+            }
+            if(ev->len == 0)
+                continue;
+
+            for(auto const & e : m_entries)
+            {
+                if(e.wd == ev->wd && e.name == ev->name)
+                    AddUnique(changed, e.path);
+            }
+        }
+    }
+
+    // events were lost, fall back to comparing the stamps once
+    if(overflow)
+    {
+        for(auto & e : m_entries)
+        {
+            if(statChanged(e))
+                AddUnique(changed, e.path);
+        }
+    }
+#else
+    (void)changed;
+#endif
+}
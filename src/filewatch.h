@@ -0,0 +1,51 @@
+#ifndef FILEWATCH_H
+#define FILEWATCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Reports files that were rewritten since the last poll. On Linux the parent directories
+// are watched with inotify (close-after-write and rename-into-place, which covers editors
+// that save through a temporary file); elsewhere, or if inotify or a watch on the file's
+// directory is unavailable, the modification time and size of the file are compared at
+// poll_interval.
+class FileWatcher
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        std::string path;
+        std::string name;   // file name without the directory
+        int         wd    = -1;
+        int64_t     mtime = 0;
+        int64_t     size  = -1;
+    };
+
+    int                       m_inotify_fd;
+    std::vector<Entry>        m_entries;
+    Clock::time_point         m_last_poll;
+    std::chrono::milliseconds m_poll_interval;
+
+    bool statChanged(Entry & e);
+    void pollStat(std::vector<std::string> & changed);
+    void pollInotify(std::vector<std::string> & changed);
+
+public:
+    FileWatcher(std::chrono::milliseconds poll_interval = std::chrono::milliseconds{500});
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher & operator=(const FileWatcher &) = delete;
+
+    // false if the file doesn't exist or can't be stat'ed, nothing is watched then
+    bool add(std::string const & path);
+    // appends changed paths, never blocks
+    void poll(std::vector<std::string> & changed);
+
+    bool usesInotify() const { return m_inotify_fd >= 0; }
+};
+
+#endif   // FILEWATCH_H
@@ -0,0 +1,243 @@
+#include "framecapture.h"
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+// upper bound for a blocking fence wait, 1 second
+constexpr GLuint64 fence_timeout_ns = 1000000000;
+}   // namespace
+
+FrameCapture::FrameCapture() :
+    m_recording{false},
+    m_has_sync{false},
+    m_policy{Backpressure::bp_drop},
+    m_width{0},
+    m_height{0},
+    m_next{0},
+    m_captured{0},
+    m_dropped{0},
+    m_max_queued{0},
+    m_next_index{0},
+    m_stop_workers{false},
+    m_written{0},
+    m_failed{0}
+{}
+
+FrameCapture::~FrameCapture()
+{
+    // GL objects must already be released by stop()
+    stopWorkers();
+}
+
+void FrameCapture::start(std::string const & prefix, int width, int height, Backpressure policy,
+                         uint32_t num_encoders, uint32_t max_queued)
+{
+    if(m_recording)
+        stop();
+
+    m_has_sync   = GLEW_ARB_sync;
+    m_policy     = policy;
+    m_width      = width;
+    m_height     = height;
+    m_next       = 0;
+    m_captured   = 0;
+    m_dropped    = 0;
+    m_written    = 0;
+    m_failed     = 0;
+    m_prefix     = prefix;
+    m_max_queued = max_queued > 0 ? max_queued : 1;
+    m_next_index = 0;
+
+    auto frame_size = static_cast<GLsizeiptr>(width) * height * 3;
+    for(auto & slot : m_slots)
+    {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frame_size, nullptr, GL_STREAM_READ);
+        slot.fence   = nullptr;
+        slot.pending = false;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    m_stop_workers = false;
+    for(uint32_t i = 0; i < (num_encoders > 0 ? num_encoders : 1); ++i)
+        m_workers.emplace_back(&FrameCapture::encoderLoop, this);
+
+    m_recording = true;
+}
+
+void FrameCapture::stop()
+{
+    if(!m_recording)
+        return;
+
+    // flush the ring oldest first so the sequence stays ordered; the encoders are still
+    // running, so waiting for queue space always finishes
+    for(uint32_t i = 0; i < ring_size; ++i)
+    {
+        auto & slot = m_slots[(m_next + i) % ring_size];
+        if(slot.pending)
+            retire(slot, true, true);
+    }
+
+    for(auto & slot : m_slots)
+    {
+        glDeleteBuffers(1, &slot.pbo);
+        slot.pbo = 0;
+    }
+
+    m_recording = false;
+    stopWorkers();
+}
+
+void FrameCapture::capture()
+{
+    if(!m_recording)
+        return;
+
+    // hand over every readback that has already completed, oldest first
+    for(uint32_t i = 0; i < ring_size; ++i)
+    {
+        auto & slot = m_slots[(m_next + i) % ring_size];
+        if(slot.pending && !retire(slot, false))
+            break;
+    }
+
+    auto & slot = m_slots[m_next];
+    if(slot.pending)
+    {
+        // The GPU is ring_size frames behind. Without fences there is no way to tell, but a
+        // readback that old is mapped with little or no stall, so it is always retired.
+        if(m_policy == Backpressure::bp_drop && m_has_sync)
+        {
+            ++m_dropped;
+            return;
+        }
+
+        retire(slot, true);
+    }
+
+    // tightly packed rows, the pack alignment is restored for other readbacks
+    GLint pack_alignment{4};
+    glGetIntegerv(GL_PACK_ALIGNMENT, &pack_alignment);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, static_cast<char *>(nullptr));
+    glPixelStorei(GL_PACK_ALIGNMENT, pack_alignment);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if(m_has_sync)
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.pending = true;
+    m_next       = (m_next + 1) % ring_size;
+    ++m_captured;
+}
+
+bool FrameCapture::retire(Slot & slot, bool wait, bool block)
+{
+    if(slot.fence != nullptr)
+    {
+        GLenum res = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? fence_timeout_ns : 0);
+        if(res == GL_TIMEOUT_EXPIRED && !wait)
+            return false;
+
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+    else if(!wait)
+    {
+        // without fences the only safe point to map is when the slot is reused
+        return false;
+    }
+
+    tex::ImageData image;
+    image.width  = static_cast<uint32_t>(m_width);
+    image.height = static_cast<uint32_t>(m_height);
+    image.type   = tex::ImageData::PixelType::pt_rgb;
+
+    auto frame_size = static_cast<size_t>(image.width) * image.height * 3;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    auto * src = static_cast<uint8_t const *>(glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+    if(src != nullptr)
+    {
+        image.data = std::make_unique<uint8_t[]>(frame_size);
+        std::memcpy(image.data.get(), src, frame_size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.pending = false;
+
+    if(image.data)
+        enqueue(std::move(image), block);
+    else
+        ++m_dropped;
+
+    return true;
+}
+
+void FrameCapture::enqueue(tex::ImageData && image, bool block)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if(m_queue.size() >= m_max_queued)
+    {
+        if(m_policy == Backpressure::bp_drop && !block)
+        {
+            ++m_dropped;
+            return;
+        }
+
+        m_space_cv.wait(lock, [this] { return m_queue.size() < m_max_queued; });
+    }
+
+    m_queue.push_back(Job{m_next_index++, std::move(image)});
+    lock.unlock();
+
+    m_work_cv.notify_one();
+}
+
+void FrameCapture::encoderLoop()
+{
+    for(;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_work_cv.wait(lock, [this] { return m_stop_workers || !m_queue.empty(); });
+
+            // drain the queue before exiting
+            if(m_queue.empty())
+                return;
+
+            job = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        m_space_cv.notify_one();
+
+        std::ostringstream file_name;
+        file_name << m_prefix << std::setw(6) << std::setfill('0') << job.index << ".tga";
+
+        if(tex::WriteTGA(file_name.str(), job.image))
+            ++m_written;
+        else
+            ++m_failed;
+    }
+}
+
+void FrameCapture::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop_workers = true;
+    }
+    m_work_cv.notify_all();
+
+    for(auto & worker : m_workers)
+        worker.join();
+    m_workers.clear();
+}
@@ -0,0 +1,101 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Include GLEW
+#include <GL/glew.h>
+
+#include "imagedata.h"
+
+// Asynchronous framebuffer recorder. glReadPixels goes into a ring of pack PBOs, each
+// guarded by a fence; a PBO is mapped only after its fence has signaled, and the copied
+// frame is handed to a pool of encoder threads that write a numbered TGA sequence.
+// When the GPU or the encoders fall behind, the recorder either waits (bp_block) or
+// drops the frame (bp_drop) and counts it. Without ARB_sync a PBO is mapped once the
+// ring wraps around to it, and only a full encoder queue drops frames.
+class FrameCapture
+{
+public:
+    enum class Backpressure
+    {
+        bp_block,
+        bp_drop
+    };
+
+    static constexpr uint32_t ring_size = 3;
+
+private:
+    struct Slot
+    {
+        GLuint pbo     = 0;
+        GLsync fence   = nullptr;
+        bool   pending = false;
+    };
+
+    struct Job
+    {
+        uint64_t       index = 0;
+        tex::ImageData image;
+    };
+
+    // render thread state
+    bool                        m_recording;
+    bool                        m_has_sync;
+    Backpressure                m_policy;
+    int                         m_width;
+    int                         m_height;
+    uint32_t                    m_next;
+    uint64_t                    m_captured;
+    uint64_t                    m_dropped;
+    std::array<Slot, ring_size> m_slots;
+    // encoder state
+    std::string                 m_prefix;
+    uint32_t                    m_max_queued;
+    uint64_t                    m_next_index;
+    bool                        m_stop_workers;
+    std::deque<Job>             m_queue;
+    std::mutex                  m_mutex;
+    std::condition_variable     m_work_cv;
+    std::condition_variable     m_space_cv;
+    std::vector<std::thread>    m_workers;
+    std::atomic<uint64_t>       m_written;
+    std::atomic<uint64_t>       m_failed;
+
+    bool retire(Slot & slot, bool wait, bool block = false);
+    void enqueue(tex::ImageData && image, bool block);
+    void encoderLoop();
+    void stopWorkers();
+
+public:
+    FrameCapture();
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture &) = delete;
+    FrameCapture & operator=(const FrameCapture &) = delete;
+
+    // start() and stop() create and delete GL objects and must be called with the
+    // capturing context current; stop() waits for every queued frame to be written, the
+    // frames still in the ring are never dropped whatever the policy
+    void start(std::string const & prefix, int width, int height, Backpressure policy = Backpressure::bp_drop,
+               uint32_t num_encoders = 2, uint32_t max_queued = 8);
+    void stop();
+    // read back the current draw buffer; call after rendering, before the buffer swap
+    void capture();
+
+    bool     isRecording() const { return m_recording; }
+    uint64_t capturedFrames() const { return m_captured; }
+    uint64_t droppedFrames() const { return m_dropped; }
+    uint64_t writtenFrames() const { return m_written; }
+    uint64_t failedFrames() const { return m_failed; }
+};
+
+#endif   // FRAMECAPTURE_H
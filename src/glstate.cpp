@@ -0,0 +1,192 @@
+#include "glstate.h"
+#include <glm/gtc/type_ptr.hpp>
+
+GLStateCache::GLStateCache() :
+    m_has_vao{false},
+    m_program{unknown_name},
+    m_texture{unknown_name},
+    m_vao{unknown_name},
+    m_array_buffer{unknown_name},
+    m_element_buffer{unknown_name},
+    m_matrix_mode{0},
+    m_vertex_array{Flag::fl_unknown},
+    m_texcoord_array{Flag::fl_unknown},
+    m_model_view{1.0f},
+    m_model_view_valid{false},
+    m_issued{0},
+    m_elided{0}
+{}
+
+void GLStateCache::init()
+{
+    m_has_vao = GLEW_ARB_vertex_array_object;
+    invalidate();
+}
+
+void GLStateCache::invalidate()
+{
+    m_program          = unknown_name;
+    m_texture          = unknown_name;
+    m_vao              = unknown_name;
+    m_matrix_mode      = 0;
+    m_model_view_valid = false;
+    invalidateVertexState();
+}
+
+void GLStateCache::invalidateVertexState()
+{
+    // all of this is part of the vertex array object state
+    m_array_buffer           = unknown_name;
+    m_element_buffer         = unknown_name;
+    m_vertex_array           = Flag::fl_unknown;
+    m_texcoord_array         = Flag::fl_unknown;
+    m_vertex_pointer.valid   = false;
+    m_texcoord_pointer.valid = false;
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+    if(m_program == program)
+    {
+        ++m_elided;
+        return;
+    }
+
+    glUseProgram(program);
+    m_program = program;
+    ++m_issued;
+}
+
+void GLStateCache::bindTexture(GLuint texture)
+{
+    if(m_texture == texture)
+    {
+        ++m_elided;
+        return;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    m_texture = texture;
+    ++m_issued;
+}
+
+void GLStateCache::bindVertexArray(GLuint vao)
+{
+    if(!m_has_vao)
+        return;
+
+    if(m_vao == vao)
+    {
+        ++m_elided;
+        return;
+    }
+
+    glBindVertexArray(vao);
+    m_vao = vao;
+    invalidateVertexState();
+    ++m_issued;
+}
+
+void GLStateCache::bindArrayBuffer(GLuint buffer)
+{
+    if(m_array_buffer == buffer)
+    {
+        ++m_elided;
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    m_array_buffer = buffer;
+    ++m_issued;
+}
+
+void GLStateCache::bindElementBuffer(GLuint buffer)
+{
+    if(m_element_buffer == buffer)
+    {
+        ++m_elided;
+        return;
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    m_element_buffer = buffer;
+    ++m_issued;
+}
+
+bool GLStateCache::clientState(GLenum array, Flag & shadow, bool enable)
+{
+    Flag req = enable ? Flag::fl_on : Flag::fl_off;
+    if(shadow == req)
+    {
+        ++m_elided;
+        return false;
+    }
+
+    if(enable)
+        glEnableClientState(array);
+    else
+        glDisableClientState(array);
+    shadow = req;
+    ++m_issued;
+
+    return true;
+}
+
+void GLStateCache::enableVertexArray(bool enable)
+{
+    clientState(GL_VERTEX_ARRAY, m_vertex_array, enable);
+}
+
+void GLStateCache::enableTexCoordArray(bool enable)
+{
+    clientState(GL_TEXTURE_COORD_ARRAY, m_texcoord_array, enable);
+}
+
+void GLStateCache::vertexPointer(GLuint buffer, GLint size, GLenum type, GLsizei stride, size_t offset)
+{
+    if(m_vertex_pointer.same(buffer, size, type, stride, offset))
+    {
+        ++m_elided;
+        return;
+    }
+
+    bindArrayBuffer(buffer);
+    glVertexPointer(size, type, stride, static_cast<char *>(nullptr) + offset);
+    m_vertex_pointer = Pointer{buffer, size, type, stride, offset, true};
+    ++m_issued;
+}
+
+void GLStateCache::texCoordPointer(GLuint buffer, GLint size, GLenum type, GLsizei stride, size_t offset)
+{
+    if(m_texcoord_pointer.same(buffer, size, type, stride, offset))
+    {
+        ++m_elided;
+        return;
+    }
+
+    bindArrayBuffer(buffer);
+    glTexCoordPointer(size, type, stride, static_cast<char *>(nullptr) + offset);
+    m_texcoord_pointer = Pointer{buffer, size, type, stride, offset, true};
+    ++m_issued;
+}
+
+void GLStateCache::loadModelView(glm::mat4 const & mv)
+{
+    if(m_model_view_valid && m_model_view == mv)
+    {
+        ++m_elided;
+        return;
+    }
+
+    if(m_matrix_mode != GL_MODELVIEW)
+    {
+        glMatrixMode(GL_MODELVIEW);
+        m_matrix_mode = GL_MODELVIEW;
+        ++m_issued;
+    }
+
+    glLoadMatrixf(glm::value_ptr(mv));
+    m_model_view       = mv;
+    m_model_view_valid = true;
+    ++m_issued;
+}
@@ -0,0 +1,89 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Include GLEW
+#include <GL/glew.h>
+// Include GLM
+#include <glm/glm.hpp>
+
+// Shadow copy of the GL state touched by the render queue. Every setter compares the
+// request with the shadow value and skips the GL call when nothing would change.
+// Code that changes the same state directly must call invalidate() afterwards.
+class GLStateCache
+{
+    struct Pointer
+    {
+        GLuint  buffer = 0;
+        GLint   size   = 0;
+        GLenum  type   = 0;
+        GLsizei stride = 0;
+        size_t  offset = 0;
+        bool    valid  = false;
+
+        bool same(GLuint b, GLint sz, GLenum t, GLsizei st, size_t off) const
+        {
+            return valid && buffer == b && size == sz && type == t && stride == st && offset == off;
+        }
+    };
+
+    // tri-state for capabilities, unknown until the first call
+    enum class Flag : int8_t
+    {
+        fl_unknown,
+        fl_off,
+        fl_on
+    };
+
+    static constexpr GLuint unknown_name = ~GLuint{0};
+
+    bool      m_has_vao;
+    GLuint    m_program;
+    GLuint    m_texture;
+    GLuint    m_vao;
+    GLuint    m_array_buffer;
+    GLuint    m_element_buffer;
+    GLenum    m_matrix_mode;
+    Flag      m_vertex_array;
+    Flag      m_texcoord_array;
+    Pointer   m_vertex_pointer;
+    Pointer   m_texcoord_pointer;
+    glm::mat4 m_model_view;
+    bool      m_model_view_valid;
+    // statistics
+    uint64_t m_issued;
+    uint64_t m_elided;
+
+    bool clientState(GLenum array, Flag & shadow, bool enable);
+    void invalidateVertexState();
+
+public:
+    GLStateCache();
+
+    GLStateCache(const GLStateCache &) = delete;
+    GLStateCache & operator=(const GLStateCache &) = delete;
+
+    // call once the context is current; forgets everything known about the old one
+    void init();
+    void invalidate();
+
+    void useProgram(GLuint program);
+    void bindTexture(GLuint texture);
+    void bindVertexArray(GLuint vao);
+    void bindArrayBuffer(GLuint buffer);
+    void bindElementBuffer(GLuint buffer);
+    void enableVertexArray(bool enable);
+    void enableTexCoordArray(bool enable);
+    void vertexPointer(GLuint buffer, GLint size, GLenum type, GLsizei stride, size_t offset);
+    void texCoordPointer(GLuint buffer, GLint size, GLenum type, GLsizei stride, size_t offset);
+    void loadModelView(glm::mat4 const & mv);
+
+    bool     hasVertexArrayObjects() const { return m_has_vao; }
+    uint64_t issuedCalls() const { return m_issued; }
+    uint64_t elidedCalls() const { return m_elided; }
+    void     resetCounters() { m_issued = m_elided = 0; }
+};
+
+#endif   // GLSTATE_H
@@ -0,0 +1,289 @@
+#include "gpuprofiler.h"
+#include <algorithm>
+#include <fstream>
+
+namespace
+{
+// bucket 0 holds samples below 1us, bucket k - samples in [2^(k-1), 2^k) us
+uint32_t HistogramBucket(float ms)
+{
+    auto     us     = static_cast<uint32_t>(std::max(ms, 0.0f) * 1000.0f);
+    uint32_t bucket = 0;
+    while(us > 0 && bucket < GpuProfiler::histogram_buckets - 1)
+    {
+        us >>= 1;
+        ++bucket;
+    }
+
+    return bucket;
+}
+
+struct Summary
+{
+    uint32_t count = 0;
+    float    mean  = 0.0f;
+    float    min   = 0.0f;
+    float    max   = 0.0f;
+    float    p95   = 0.0f;
+};
+
+Summary Summarize(std::vector<float> & samples)
+{
+    Summary res;
+    if(samples.empty())
+        return res;
+
+    std::sort(samples.begin(), samples.end());
+
+    float sum = 0.0f;
+    for(float s : samples)
+        sum += s;
+
+    res.count = static_cast<uint32_t>(samples.size());
+    res.mean  = sum / static_cast<float>(samples.size());
+    res.min   = samples.front();
+    res.max   = samples.back();
+    res.p95   = samples[(samples.size() - 1) * 95 / 100];
+
+    return res;
+}
+
+void WriteSummary(std::ofstream & ofile, Summary const & s)
+{
+    ofile << "{\"count\": " << s.count << ", \"mean\": " << s.mean << ", \"min\": " << s.min
+          << ", \"max\": " << s.max << ", \"p95\": " << s.p95 << "}";
+}
+
+void WriteHistogram(std::ofstream & ofile, std::array<uint32_t, GpuProfiler::histogram_buckets> const & h)
+{
+    ofile << "[";
+    for(uint32_t i = 0; i < h.size(); ++i)
+        ofile << (i ? ", " : "") << h[i];
+    ofile << "]";
+}
+}   // namespace
+
+void GpuProfiler::PassStats::add(PassRecord const & rec)
+{
+    if(count == history_size)
+    {
+        auto const & old = history[head];
+        --cpu_histogram[HistogramBucket(old.cpu_ms)];
+        if(old.gpu_ms >= 0.0f)
+            --gpu_histogram[HistogramBucket(old.gpu_ms)];
+    }
+    else
+        ++count;
+
+    history[head] = rec;
+    head          = (head + 1) % history_size;
+
+    ++cpu_histogram[HistogramBucket(rec.cpu_ms)];
+    if(rec.gpu_ms >= 0.0f)
+        ++gpu_histogram[HistogramBucket(rec.gpu_ms)];
+}
+
+GpuProfiler::GpuProfiler() : m_has_timer{false}, m_in_pass{false}, m_frame{0}, m_dropped_frames{0} {}
+
+void GpuProfiler::init()
+{
+    m_has_timer = GLEW_ARB_timer_query;
+    m_in_pass   = false;
+
+    for(auto & slot : m_slots)
+    {
+        slot.used       = false;
+        slot.num_passes = 0;
+        if(m_has_timer)
+            glGenQueries(max_passes, slot.queries.data());
+    }
+}
+
+void GpuProfiler::release()
+{
+    if(m_in_pass)
+        endPass();
+
+    for(auto & slot : m_slots)
+    {
+        // results of the in-flight frames are lost with the context
+        if(slot.used && m_has_timer)
+            ++m_dropped_frames;
+        slot.used       = false;
+        slot.num_passes = 0;
+
+        if(m_has_timer)
+        {
+            glDeleteQueries(max_passes, slot.queries.data());
+            slot.queries.fill(0);
+        }
+    }
+
+    m_has_timer = false;
+}
+
+uint32_t GpuProfiler::passIndex(char const * name)
+{
+    for(uint32_t i = 0; i < m_stats.size(); ++i)
+    {
+        if(m_stats[i].name == name)
+            return i;
+    }
+
+    m_stats.emplace_back();
+    m_stats.back().name = name;
+
+    return static_cast<uint32_t>(m_stats.size() - 1);
+}
+
+void GpuProfiler::resolve(FrameSlot & slot)
+{
+    if(!slot.used)
+        return;
+
+    // queries complete in submission order, so checking the last one is enough
+    bool gpu_ready = false;
+    if(m_has_timer && slot.num_passes > 0)
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(slot.queries[slot.num_passes - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        gpu_ready = available != 0;
+        if(!gpu_ready)
+            ++m_dropped_frames;
+    }
+
+    for(uint32_t i = 0; i < slot.num_passes; ++i)
+    {
+        auto const & pass = slot.passes[i];
+
+        PassRecord rec;
+        rec.frame  = slot.frame;
+        rec.cpu_ms = std::chrono::duration<float, std::milli>(pass.cpu_end - pass.cpu_begin).count();
+        if(gpu_ready)
+        {
+            GLuint64 elapsed_ns = 0;
+            glGetQueryObjectui64v(slot.queries[i], GL_QUERY_RESULT, &elapsed_ns);
+            rec.gpu_ms = static_cast<float>(elapsed_ns) * 1.0e-6f;
+        }
+
+        m_stats[pass.pass].add(rec);
+    }
+
+    slot.used       = false;
+    slot.num_passes = 0;
+}
+
+void GpuProfiler::beginFrame()
+{
+    ++m_frame;
+    auto & slot = m_slots[m_frame % frame_latency];
+
+    resolve(slot);
+
+    slot.frame      = m_frame;
+    slot.used       = true;
+    slot.num_passes = 0;
+}
+
+void GpuProfiler::endFrame()
+{
+    if(m_in_pass)
+        endPass();
+}
+
+void GpuProfiler::beginPass(char const * name)
+{
+    auto & slot = m_slots[m_frame % frame_latency];
+    if(m_in_pass || !slot.used || slot.num_passes == max_passes)
+        return;
+
+    auto & pass = slot.passes[slot.num_passes];
+    pass.pass   = passIndex(name);
+    m_in_pass   = true;
+
+    if(m_has_timer)
+        glBeginQuery(GL_TIME_ELAPSED, slot.queries[slot.num_passes]);
+    pass.cpu_begin = Clock::now();
+}
+
+void GpuProfiler::endPass()
+{
+    if(!m_in_pass)
+        return;
+
+    auto & slot = m_slots[m_frame % frame_latency];
+    auto & pass = slot.passes[slot.num_passes];
+
+    pass.cpu_end = Clock::now();
+    if(m_has_timer)
+        glEndQuery(GL_TIME_ELAPSED);
+
+    ++slot.num_passes;
+    m_in_pass = false;
+}
+
+bool GpuProfiler::writeCSV(std::string const & file_name) const
+{
+    std::ofstream ofile(file_name);
+    if(!ofile.is_open())
+        return false;
+
+    ofile << "pass,frame,cpu_ms,gpu_ms\n";
+    for(auto const & st : m_stats)
+    {
+        for(uint32_t i = 0; i < st.count; ++i)
+        {
+            auto const & rec = st.history[(st.head + history_size - st.count + i) % history_size];
+
+            ofile << st.name << ',' << rec.frame << ',' << rec.cpu_ms << ',';
+            if(rec.gpu_ms >= 0.0f)
+                ofile << rec.gpu_ms;
+            ofile << '\n';
+        }
+    }
+
+    return !ofile.fail();
+}
+
+bool GpuProfiler::writeJSON(std::string const & file_name) const
+{
+    std::ofstream ofile(file_name);
+    if(!ofile.is_open())
+        return false;
+
+    ofile << "{\n  \"gpu_timer\": " << (m_has_timer ? "true" : "false") << ",\n  \"frames\": " << m_frame
+          << ",\n  \"dropped_frames\": " << m_dropped_frames << ",\n  \"histogram_upper_us\": [";
+    // the last bucket also collects everything above, it has no upper bound
+    for(uint32_t i = 0; i + 1 < histogram_buckets; ++i)
+        ofile << (i ? ", " : "") << (1u << i);
+    ofile << ", null";
+    ofile << "],\n  \"passes\": [";
+
+    std::vector<float> cpu, gpu;
+    for(uint32_t p = 0; p < m_stats.size(); ++p)
+    {
+        auto const & st = m_stats[p];
+
+        cpu.clear();
+        gpu.clear();
+        for(uint32_t i = 0; i < st.count; ++i)
+        {
+            cpu.push_back(st.history[i].cpu_ms);
+            if(st.history[i].gpu_ms >= 0.0f)
+                gpu.push_back(st.history[i].gpu_ms);
+        }
+
+        ofile << (p ? ",\n" : "\n") << "    {\"name\": \"" << st.name << "\",\n     \"cpu_ms\": ";
+        WriteSummary(ofile, Summarize(cpu));
+        ofile << ",\n     \"gpu_ms\": ";
+        WriteSummary(ofile, Summarize(gpu));
+        ofile << ",\n     \"cpu_histogram\": ";
+        WriteHistogram(ofile, st.cpu_histogram);
+        ofile << ",\n     \"gpu_histogram\": ";
+        WriteHistogram(ofile, st.gpu_histogram);
+        ofile << "}";
+    }
+    ofile << "\n  ]\n}\n";
+
+    return !ofile.fail();
+}
@@ -0,0 +1,97 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Include GLEW
+#include <GL/glew.h>
+
+// Per-pass frame profiler. Every pass is wrapped in a GL_TIME_ELAPSED query; queries of
+// a frame are read back frame_latency frames later, so the results are (almost) always
+// available and reading them never stalls the pipeline. Frames whose queries are still
+// pending at that point are dropped from the GPU statistics instead of waiting.
+class GpuProfiler
+{
+public:
+    static constexpr uint32_t frame_latency     = 4;     // frames in flight before readback
+    static constexpr uint32_t max_passes        = 8;     // passes per frame
+    static constexpr uint32_t history_size      = 256;   // rolling window, frames
+    static constexpr uint32_t histogram_buckets = 16;    // log2 buckets in microseconds
+
+    struct PassRecord
+    {
+        uint64_t frame  = 0;
+        float    cpu_ms = 0.0f;
+        float    gpu_ms = -1.0f;   // negative if there is no GPU sample
+    };
+
+    struct PassStats
+    {
+        std::string                             name;
+        std::array<PassRecord, history_size>    history;
+        uint32_t                                head  = 0;
+        uint32_t                                count = 0;
+        std::array<uint32_t, histogram_buckets> cpu_histogram{};
+        std::array<uint32_t, histogram_buckets> gpu_histogram{};
+
+        void add(PassRecord const & rec);
+    };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct PassQuery
+    {
+        uint32_t          pass = 0;
+        Clock::time_point cpu_begin;
+        Clock::time_point cpu_end;
+    };
+
+    struct FrameSlot
+    {
+        uint64_t                          frame      = 0;
+        bool                              used       = false;
+        uint32_t                          num_passes = 0;
+        std::array<PassQuery, max_passes> passes;
+        std::array<GLuint, max_passes>    queries{};
+    };
+
+    bool                                 m_has_timer;
+    bool                                 m_in_pass;
+    uint64_t                             m_frame;
+    uint64_t                             m_dropped_frames;
+    std::array<FrameSlot, frame_latency> m_slots;
+    std::vector<PassStats>               m_stats;
+
+    uint32_t passIndex(char const * name);
+    void     resolve(FrameSlot & slot);
+
+public:
+    GpuProfiler();
+
+    GpuProfiler(const GpuProfiler &) = delete;
+    GpuProfiler & operator=(const GpuProfiler &) = delete;
+
+    // GL objects are owned by the current context: init() after the context is made
+    // current, release() while it is still current (queries are not shared between contexts)
+    void init();
+    void release();
+
+    void beginFrame();
+    void endFrame();
+    void beginPass(char const * name);
+    void endPass();
+
+    bool                           hasGpuTimer() const { return m_has_timer; }
+    uint64_t                       droppedFrames() const { return m_dropped_frames; }
+    std::vector<PassStats> const & stats() const { return m_stats; }
+
+    bool writeCSV(std::string const & file_name) const;
+    bool writeJSON(std::string const & file_name) const;
+};
+
+#endif   // GPUPROFILER_H
@@ -1,8 +1,10 @@
 #include "imagedata.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <cstring>
 #include <vector>
 #include <fstream>
-#include <iostream>
 
 #pragma pack(push, 1)
 struct BITMAPFILEHEADER
@@ -55,178 +57,366 @@ struct TGAHEADER
 };
 #pragma pack(pop)
 
-namespace tex
+namespace
 {
-//==============================================================================
-//         Read BMP section
-//==============================================================================
-bool ReadBMP(std::string const & file_name, ImageData & id)
+// Everything the decode loops need. Filled only once every byte they are going to read
+// is known to lie inside the input, so the loops themselves carry no bounds checks.
+struct BMPLayout
 {
-    bool   res         = false;
-    bool   compressed  = false;
-    bool   flip        = false;
-    size_t file_length = 0;
+    uint8_t const * pixels;
+    size_t          line_length;
+    uint32_t        width;
+    uint32_t        height;
+    uint32_t        bytes_per_pixel;
+    bool            bitfields;   // BI_BITFIELDS / BI_ALPHABITFIELDS, alpha comes first
+    bool            top_down;
+};
 
-    id.width  = 0;
-    id.height = 0;
-    id.type   = ImageData::PixelType::pt_none;
-    if(id.data)
-        id.data.reset(nullptr);
+struct TGALayout
+{
+    uint8_t const * pixels;
+    size_t          span;   // bytes of pixel or packet data the decoder consumes
+    uint32_t        width;
+    uint32_t        height;
+    uint32_t        bytes_per_pixel;
+    bool            rle;
+    bool            flip_horizontal;
+    bool            flip_vertical;
+};
 
-    std::ifstream        ifile(file_name, std::ios::binary);
-    std::vector<uint8_t> file;
+bool ValidateBMP(uint8_t const * data, size_t size, BMPLayout & layout)
+{
+    BITMAPFILEHEADER file_header;
+    uint32_t         info_size = 0;
+    if(size < sizeof(file_header) + sizeof(info_size))
+        return false;
 
-    if(ifile.is_open())
+    std::memcpy(&file_header, data, sizeof(file_header));
+    std::memcpy(&info_size, data + sizeof(file_header), sizeof(info_size));
+    if(file_header.bfSize != size || file_header.bfType != 0x4D42)   // little-endian
+        return false;
+
+    int64_t  width       = 0;
+    int64_t  height      = 0;
+    uint16_t bit_count   = 0;
+    uint32_t compression = 0;
+    if(info_size == sizeof(BITMAPINFO12))
     {
-        ifile.seekg(0, std::ios_base::end);
-        auto length = ifile.tellg();
-        ifile.seekg(0, std::ios_base::beg);
+        BITMAPINFO12 info;
+        if(size - sizeof(file_header) < sizeof(info))
+            return false;
 
-        file.resize(static_cast<size_t>(length));
+        std::memcpy(&info, data + sizeof(file_header), sizeof(info));
+        width     = info.biWidth;
+        height    = info.biHeight;
+        bit_count = info.biBitCount;
+    }
+    else
+    {
+        // V4 and V5 headers extend BITMAPINFO, only its fields are used
+        BITMAPINFO info;
+        if(info_size < sizeof(info) || size - sizeof(file_header) < info_size)
+            return false;
 
-        ifile.read(reinterpret_cast<char *>(file.data()), length);
+        std::memcpy(&info, data + sizeof(file_header), sizeof(info));
+        width       = info.biWidth;
+        height      = info.biHeight;
+        bit_count   = info.biBitCount;
+        compression = info.biCompression;
+    }
 
-        auto success = !ifile.fail() && length == ifile.gcount();
-        ifile.close();
+    if((bit_count != 24 && bit_count != 32) || (compression != 0 && compression != 3 && compression != 6))
+        return false;
 
-        if(!success)
-            return false;
-    }
-    else
+    if(width <= 0 || height == 0)
         return false;
 
-    file_length = file.size();
-    if(file_length == 0)
-        return res;
+    layout.top_down        = height < 0;
+    layout.bitfields       = compression != 0;
+    layout.bytes_per_pixel = bit_count / 8u;
+    height                 = std::abs(height);
 
-    auto * buffer = file.data();
+    // rows are padded to 4 bytes; the pixel array has to fit between bfOffBits and the end
+    uint64_t const line_length = (static_cast<uint64_t>(width) * layout.bytes_per_pixel + 3) & ~uint64_t{3};
+    uint64_t const header_end  = sizeof(file_header) + uint64_t{info_size};
+    if(file_header.bfOffBits < header_end || file_header.bfOffBits > size)
+        return false;
 
-    auto *             pPtr    = buffer;
-    BITMAPFILEHEADER * pHeader = reinterpret_cast<BITMAPFILEHEADER *>(pPtr);
-    pPtr += sizeof(BITMAPFILEHEADER);
-    if(pHeader->bfSize != file_length || pHeader->bfType != 0x4D42)   // little-endian
-        return res;
+    if(static_cast<uint64_t>(height) > (size - file_header.bfOffBits) / line_length)
+        return false;
 
-    if(reinterpret_cast<uint32_t *>(pPtr)[0] == 12)
-    {
-        BITMAPINFO12 * pInfo = reinterpret_cast<BITMAPINFO12 *>(pPtr);
+    layout.pixels      = data + file_header.bfOffBits;
+    layout.line_length = static_cast<size_t>(line_length);
+    layout.width       = static_cast<uint32_t>(width);
+    layout.height      = static_cast<uint32_t>(height);
 
-        if(pInfo->biBitCount != 24 && pInfo->biBitCount != 32)
-            return res;
+    return true;
+}
 
-        if(pInfo->biBitCount == 24)
-            id.type = ImageData::PixelType::pt_rgb;
-        else
-            id.type = ImageData::PixelType::pt_rgba;
+bool ValidateTGA(uint8_t const * data, size_t size, TGALayout & layout)
+{
+    TGAHEADER header;
+    if(size < sizeof(header))
+        return false;
 
-        id.width  = pInfo->biWidth;
-        id.height = pInfo->biHeight;
-    }
-    else
-    {
-        BITMAPINFO * pInfo = reinterpret_cast<BITMAPINFO *>(pPtr);
+    std::memcpy(&header, data, sizeof(header));
+    if((header.datatypecode != 2 && header.datatypecode != 10) || header.width == 0 || header.height == 0
+       || (header.bitsperpixel != 24 && header.bitsperpixel != 32))   // Make sure all information is valid
+        return false;
 
-        if(pInfo->biBitCount != 24 && pInfo->biBitCount != 32)
-            return res;
+    // the image ID and a colour map, if any, sit between the header and the pixels
+    uint64_t offset = sizeof(header) + uint64_t{header.idlength};
+    if(header.colourmaptype == 1)
+        offset += uint64_t{header.colourmaplength} * ((header.colourmapdepth + 7u) / 8u);
+    if(offset > size)
+        return false;
 
-        if(pInfo->biCompression != 3 && pInfo->biCompression != 6 && pInfo->biCompression != 0)
-        {
-            return res;
-        }
+    layout.pixels          = data + offset;
+    layout.width           = header.width;
+    layout.height          = header.height;
+    layout.bytes_per_pixel = header.bitsperpixel / 8u;
+    layout.rle             = header.datatypecode == 10;
+    layout.flip_horizontal = (header.imagedescriptor & 0x10) != 0;
+    layout.flip_vertical   = (header.imagedescriptor & 0x20) != 0;
 
-        if(pInfo->biCompression == 3 || pInfo->biCompression == 6)
-        {
-            compressed = true;
-        }
+    uint64_t const available   = size - offset;
+    uint64_t const pixel_count = uint64_t{layout.width} * layout.height;
 
-        if(pInfo->biBitCount == 24)
-            id.type = ImageData::PixelType::pt_rgb;
-        else
-            id.type = ImageData::PixelType::pt_rgba;
+    if(!layout.rle)
+    {
+        if(pixel_count * layout.bytes_per_pixel > available)
+            return false;
+
+        layout.span = static_cast<size_t>(pixel_count * layout.bytes_per_pixel);
+        return true;
+    }
+
+    // Walk the packet headers only: every packet has to be complete and the last one has
+    // to end exactly on the last pixel
+    uint64_t pos     = 0;
+    uint64_t decoded = 0;
+    while(decoded < pixel_count)
+    {
+        if(pos == available)
+            return false;
 
-        id.width = static_cast<uint32_t>(pInfo->biWidth);
+        uint8_t const  chunk = layout.pixels[pos++];
+        uint32_t const count = (chunk & 0x7Fu) + 1;
+        uint64_t const bytes = (chunk & 0x80) ? layout.bytes_per_pixel : uint64_t{count} * layout.bytes_per_pixel;
+        if(count > pixel_count - decoded || bytes > available - pos)
+            return false;
 
-        if(pInfo->biHeight < 0)
-            flip = true;
-        id.height = static_cast<uint32_t>(std::abs(pInfo->biHeight));
+        pos += bytes;
+        decoded += count;
     }
 
-    // read data:
-    pPtr                     = buffer + pHeader->bfOffBits;
-    uint32_t lineLength      = 0;
-    uint32_t bytes_per_pixel = (id.type == ImageData::PixelType::pt_rgb ? 3 : 4);
-    auto     image           = std::make_unique<uint8_t[]>(id.width * id.height * bytes_per_pixel);
-    uint8_t  red, green, blue, alpha;
-    uint32_t w_ind(0), h_ind(0);
+    layout.span = static_cast<size_t>(pos);
+    return true;
+}
 
-    if(id.type == ImageData::PixelType::pt_rgb)
-        lineLength = id.width * bytes_per_pixel + id.width % 4;
-    else
-        lineLength = id.width * bytes_per_pixel;
+void DecodeBMPPixels(BMPLayout const & layout, tex::ImageData & id)
+{
+    uint32_t const bpp       = layout.bytes_per_pixel;
+    size_t const   row_bytes = static_cast<size_t>(layout.width) * bpp;
+    auto           image     = std::make_unique<uint8_t[]>(row_bytes * layout.height);
 
-    for(uint32_t i = 0; i < id.height; ++i)
+    for(uint32_t i = 0; i < layout.height; ++i)
     {
-        w_ind = 0;
-        for(uint32_t j = 0; j < lineLength; j += bytes_per_pixel)
-        {
-            if(j > id.width * bytes_per_pixel)
-                continue;
+        // top-down files are stored first row first, ImageData starts at the bottom
+        uint8_t const * src = layout.pixels + i * layout.line_length;
+        uint8_t *       dst = image.get() + (layout.top_down ? layout.height - 1 - i : i) * row_bytes;
 
-            if(compressed)
+        if(bpp == 3)
+        {
+            for(uint32_t j = 0; j < layout.width; ++j, src += 3, dst += 3)
             {
-                uint32_t count = 0;
-                if(id.type == ImageData::PixelType::pt_rgba)
-                {
-                    alpha = pPtr[i * lineLength + j + count];
-                    count++;
-                }
-                blue = pPtr[i * lineLength + j + count];
-                count++;
-                green = pPtr[i * lineLength + j + count];
-                count++;
-                red = pPtr[i * lineLength + j + count];
+                dst[0] = src[2];
+                dst[1] = src[1];
+                dst[2] = src[0];
             }
-            else
+        }
+        else if(layout.bitfields)
+        {
+            for(uint32_t j = 0; j < layout.width; ++j, src += 4, dst += 4)
             {
-                blue  = pPtr[i * lineLength + j + 0];
-                green = pPtr[i * lineLength + j + 1];
-                red   = pPtr[i * lineLength + j + 2];
-                if(id.type == ImageData::PixelType::pt_rgba)   // !!!Not supported - the high byte in each
-                                                               // DWORD is not used
-                    alpha = pPtr
-                        [i * lineLength + j
-                         + 3];   // https://msdn.microsoft.com/en-us/library/windows/desktop/dd183376(v=vs.85).aspx
+                dst[0] = src[3];
+                dst[1] = src[2];
+                dst[2] = src[1];
+                dst[3] = src[0];
             }
+        }
+        else
+        {
+            // !!!Not supported - the high byte in each DWORD is not used
+            // https://msdn.microsoft.com/en-us/library/windows/desktop/dd183376(v=vs.85).aspx
+            for(uint32_t j = 0; j < layout.width; ++j, src += 4, dst += 4)
+            {
+                dst[0] = src[2];
+                dst[1] = src[1];
+                dst[2] = src[0];
+                dst[3] = src[3];
+            }
+        }
+    }
 
-            image[h_ind * id.width * bytes_per_pixel + w_ind * bytes_per_pixel + 0] = red;
-            image[h_ind * id.width * bytes_per_pixel + w_ind * bytes_per_pixel + 1] = green;
-            image[h_ind * id.width * bytes_per_pixel + w_ind * bytes_per_pixel + 2] = blue;
-            if(id.type == ImageData::PixelType::pt_rgba)
-                image[h_ind * id.width * bytes_per_pixel + w_ind * bytes_per_pixel + 3] = alpha;
-            w_ind++;
+    id.width  = layout.width;
+    id.height = layout.height;
+    id.type   = bpp == 3 ? tex::ImageData::PixelType::pt_rgb : tex::ImageData::PixelType::pt_rgba;
+    id.data   = std::move(image);
+}
+
+// BGR(A) to RGB(A); the pixel size is a template argument so the loops below unroll
+template<uint32_t Bpp>
+inline void CopyTGAPixel(uint8_t * dst, uint8_t const * src)
+{
+    dst[0] = src[2];
+    dst[1] = src[1];
+    dst[2] = src[0];
+    if(Bpp == 4)
+        dst[3] = src[3];
+}
+
+template<uint32_t Bpp>
+void DecodeTGAData(uint8_t const * src, uint8_t * dst, uint8_t * const end, bool rle)
+{
+    if(!rle)
+    {
+        for(; dst != end; dst += Bpp, src += Bpp)
+            CopyTGAPixel<Bpp>(dst, src);
+        return;
+    }
+
+    // the pre-scan guarantees packets end exactly at the end of the image
+    while(dst != end)
+    {
+        uint8_t const  chunk = *src++;
+        uint32_t const count = (chunk & 0x7Fu) + 1;
+
+        if(chunk & 0x80)
+        {
+            for(uint32_t k = 0; k < count; ++k, dst += Bpp)
+                CopyTGAPixel<Bpp>(dst, src);
+            src += Bpp;
+        }
+        else
+        {
+            for(uint32_t k = 0; k < count; ++k, dst += Bpp, src += Bpp)
+                CopyTGAPixel<Bpp>(dst, src);
         }
-        h_ind++;
     }
+}
 
-    // flip image if necessary
-    if(flip)
+// both flips in place: whole rows swapped top to bottom, pixels swapped within a row
+template<uint32_t Bpp>
+void FlipTGA(uint8_t * img, uint32_t width, uint32_t height, bool flip_horizontal, bool flip_vertical)
+{
+    size_t const row_bytes = static_cast<size_t>(width) * Bpp;
+
+    if(flip_vertical)
     {
-        auto temp_buf = std::make_unique<uint8_t[]>(id.width * id.height * bytes_per_pixel);
+        std::vector<uint8_t> row(row_bytes);
+        for(uint32_t i = 0; i < height / 2; ++i)
+        {
+            uint8_t * top    = img + i * row_bytes;
+            uint8_t * bottom = img + (height - 1 - i) * row_bytes;
+            std::memcpy(row.data(), top, row_bytes);
+            std::memcpy(top, bottom, row_bytes);
+            std::memcpy(bottom, row.data(), row_bytes);
+        }
+    }
 
-        for(uint32_t i = 0; i < id.height; i++)
+    if(flip_horizontal)
+    {
+        for(uint32_t i = 0; i < height; ++i)
         {
-            std::memcpy(temp_buf.get() + i * id.width * bytes_per_pixel,
-                        image.get() + (id.height - 1 - i) * id.width * bytes_per_pixel,
-                        id.width * bytes_per_pixel);
+            uint8_t * left  = img + i * row_bytes;
+            uint8_t * right = left + row_bytes - Bpp;
+            for(; left < right; left += Bpp, right -= Bpp)
+                std::swap_ranges(left, left + Bpp, right);
         }
+    }
+}
+
+void DecodeTGAPixels(TGALayout const & layout, tex::ImageData & id)
+{
+    uint32_t const bpp        = layout.bytes_per_pixel;
+    size_t const   image_size = static_cast<size_t>(layout.width) * layout.height * bpp;
+    auto           img        = std::make_unique<uint8_t[]>(image_size);
 
-        image = std::move(temp_buf);
+    if(bpp == 3)
+    {
+        DecodeTGAData<3>(layout.pixels, img.get(), img.get() + image_size, layout.rle);
+        FlipTGA<3>(img.get(), layout.width, layout.height, layout.flip_horizontal, layout.flip_vertical);
+    }
+    else
+    {
+        DecodeTGAData<4>(layout.pixels, img.get(), img.get() + image_size, layout.rle);
+        FlipTGA<4>(img.get(), layout.width, layout.height, layout.flip_horizontal, layout.flip_vertical);
     }
 
-    id.data = std::move(image);
-    res     = true;
+    id.width  = layout.width;
+    id.height = layout.height;
+    id.type   = bpp == 3 ? tex::ImageData::PixelType::pt_rgb : tex::ImageData::PixelType::pt_rgba;
+    id.data   = std::move(img);
+}
+
+bool ReadFile(std::string const & file_name, std::vector<uint8_t> & file)
+{
+    std::ifstream ifile(file_name, std::ios::binary);
+    if(!ifile.is_open())
+        return false;
+
+    ifile.seekg(0, std::ios_base::end);
+    auto length = ifile.tellg();
+    ifile.seekg(0, std::ios_base::beg);
+
+    file.resize(static_cast<size_t>(length));
+
+    ifile.read(reinterpret_cast<char *>(file.data()), length);
+
+    auto success = !ifile.fail() && length == ifile.gcount();
+    ifile.close();
+
+    return success && !file.empty();
+}
+
+void ClearImage(tex::ImageData & id)
+{
+    id.width  = 0;
+    id.height = 0;
+    id.type   = tex::ImageData::PixelType::pt_none;
+    if(id.data)
+        id.data.reset(nullptr);
+}
+
+}   // namespace
 
-    return res;
+namespace tex
+{
+//==============================================================================
+//         Read BMP section
+//==============================================================================
+bool DecodeBMP(uint8_t const * data, size_t size, ImageData & id)
+{
+    ClearImage(id);
+
+    BMPLayout layout;
+    if(data == nullptr || !ValidateBMP(data, size, layout))
+        return false;
+
+    DecodeBMPPixels(layout, id);
+    return true;
+}
+
+bool ReadBMP(std::string const & file_name, ImageData & id)
+{
+    ClearImage(id);
+
+    std::vector<uint8_t> file;
+    if(!ReadFile(file_name, file))
+        return false;
+
+    return DecodeBMP(file.data(), file.size(), id);
 }
 
 //==============================================================================
@@ -242,10 +432,11 @@ bool WriteTGA(std::string file_name, ImageData const & id)
     tga.width        = static_cast<uint16_t>(id.width);
     tga.height       = static_cast<uint16_t>(id.height);
     tga.bitsperpixel = static_cast<uint8_t>(bytes_per_pixel * 8);
+    // rows bottom to top, pixels left to right, as stored in ImageData
     if(id.type == ImageData::PixelType::pt_rgb)
-        tga.imagedescriptor = 0x10;
+        tga.imagedescriptor = 0x00;
     else
-        tga.imagedescriptor = 0x18;
+        tga.imagedescriptor = 0x08;   // 8 alpha bits
 
     std::vector<uint8_t> out_data;
     out_data.resize(sizeof(tga));
@@ -278,252 +469,38 @@ bool WriteTGA(std::string file_name, ImageData const & id)
     return true;
 }
 
-bool ReadUncompressedTGA(ImageData & id, char * data);
-bool ReadCompressedTGA(ImageData & id, char * data);
-
-bool ReadTGA(std::string const & file_name, ImageData & id)
+bool DecodeTGA(uint8_t const * data, size_t size, ImageData & id)
 {
-    size_t file_length = 0;
-
-    std::ifstream     ifile(file_name, std::ios::binary);
-    std::vector<char> file;
-
-    if(ifile.is_open())
-    {
-        ifile.seekg(0, std::ios_base::end);
-        auto length = ifile.tellg();
-        ifile.seekg(0, std::ios_base::beg);
-
-        file.resize(static_cast<size_t>(length));
+    ClearImage(id);
 
-        ifile.read(reinterpret_cast<char *>(file.data()), length);
-
-        auto success = !ifile.fail() && length == ifile.gcount();
-        ifile.close();
-
-        if(!success)
-            return false;
-    }
-    else
-        return false;
-
-    file_length = file.size();
-    if(file_length == 0)
+    TGALayout layout;
+    if(data == nullptr || !ValidateTGA(data, size, layout))
         return false;
 
-    auto * buffer = file.data();
-
-    auto        pPtr    = buffer;
-    TGAHEADER * pHeader = reinterpret_cast<TGAHEADER *>(pPtr);
-
-    if(pHeader->datatypecode == 2)
-    {
-        return ReadUncompressedTGA(id, buffer);
-    }
-    else if(pHeader->datatypecode == 10)
-    {
-        return ReadCompressedTGA(id, buffer);
-    }
-
-    return false;
+    DecodeTGAPixels(layout, id);
+    return true;
 }
 
-bool ReadUncompressedTGA(ImageData & id, char * data)
+bool ReadTGA(std::string const & file_name, ImageData & id)
 {
-    char *      pPtr    = data;
-    TGAHEADER * pHeader = reinterpret_cast<TGAHEADER *>(pPtr);
-    pPtr += sizeof(TGAHEADER);
+    ClearImage(id);
 
-    if((pHeader->width == 0) || (pHeader->height == 0)
-       || ((pHeader->bitsperpixel != 24)
-           && (pHeader->bitsperpixel != 32)))   // Make sure all information is valid
-    {
+    std::vector<uint8_t> file;
+    if(!ReadFile(file_name, file))
         return false;
-    }
-
-    id.width  = pHeader->width;
-    id.height = pHeader->height;
-    id.type   = pHeader->bitsperpixel == 24 ? ImageData::PixelType::pt_rgb : ImageData::PixelType::pt_rgba;
-    bool flip_horizontal = (pHeader->imagedescriptor & 0x10);
-    bool flip_vertical   = (pHeader->imagedescriptor & 0x20);
-
-    uint32_t bytes_per_pixel = pHeader->bitsperpixel / 8;
-    uint32_t image_size      = id.width * id.height * bytes_per_pixel;
-
-    auto img = std::make_unique<uint8_t[]>(image_size);
-
-    for(uint32_t i = 0; i < id.width * id.height; ++i)
-    {
-        char red, green, blue, alpha;
-
-        red   = pPtr[i * bytes_per_pixel + 2];
-        green = pPtr[i * bytes_per_pixel + 1];
-        blue  = pPtr[i * bytes_per_pixel + 0];
-        if(id.type == ImageData::PixelType::pt_rgba)
-            alpha = pPtr[i * bytes_per_pixel + 3];
-
-        img[i * bytes_per_pixel + 0] = static_cast<uint8_t>(red);
-        img[i * bytes_per_pixel + 1] = static_cast<uint8_t>(green);
-        img[i * bytes_per_pixel + 2] = static_cast<uint8_t>(blue);
-        if(id.type == ImageData::PixelType::pt_rgba)
-            img[i * bytes_per_pixel + 3] = static_cast<uint8_t>(alpha);
-    }
-
-    if(flip_vertical)
-    {
-        auto flipped_img = std::make_unique<uint8_t[]>(image_size);
 
-        for(uint32_t i = 0; i < id.height; i++)
-        {
-            std::memcpy(flipped_img.get() + i * id.width * bytes_per_pixel,
-                        img.get() + (id.height - 1 - i) * id.width * bytes_per_pixel,
-                        id.width * bytes_per_pixel);
-        }
-
-        img = std::move(flipped_img);
-    }
-
-    if(flip_horizontal)
-    {
-        auto flipped_img = std::make_unique<uint8_t[]>(image_size);
-
-        for(uint32_t i = 0; i < id.height; i++)
-        {
-            for(uint32_t j = 0; j < id.width; j++)
-            {
-                flipped_img[id.width * bytes_per_pixel * i + j * bytes_per_pixel + 0] =
-                    img[id.width * bytes_per_pixel * i + (id.width - j - 1) * bytes_per_pixel + 0];
-                flipped_img[id.width * bytes_per_pixel * i + j * bytes_per_pixel + 1] =
-                    img[id.width * bytes_per_pixel * i + (id.width - j - 1) * bytes_per_pixel + 1];
-                flipped_img[id.width * bytes_per_pixel * i + j * bytes_per_pixel + 2] =
-                    img[id.width * bytes_per_pixel * i + (id.width - j - 1) * bytes_per_pixel + 2];
-                if(id.type == ImageData::PixelType::pt_rgba)
-                    flipped_img[id.width * bytes_per_pixel * i + j * bytes_per_pixel + 3] =
-                        img[id.width * bytes_per_pixel * i + (id.width - j - 1) * bytes_per_pixel + 3];
-            }
-        }
-
-        img = std::move(flipped_img);
-    }
-
-    id.data = std::move(img);
-    return true;
+    return DecodeTGA(file.data(), file.size(), id);
 }
 
-bool ReadCompressedTGA(ImageData & id, char * data)
+bool ReadImage(std::string const & file_name, ImageData & id)
 {
-    char *      pPtr    = data;
-    TGAHEADER * pHeader = reinterpret_cast<TGAHEADER *>(pPtr);
-    pPtr += sizeof(TGAHEADER);
-
-    if((pHeader->width == 0) || (pHeader->height == 0)
-       || ((pHeader->bitsperpixel != 24)
-           && (pHeader->bitsperpixel != 32)))   // Make sure all information is valid
-    {
-        return false;
-    }
-
-    id.width  = pHeader->width;
-    id.height = pHeader->height;
-    id.type   = pHeader->bitsperpixel == 24 ? ImageData::PixelType::pt_rgb : ImageData::PixelType::pt_rgba;
-    bool flip_horizontal = (pHeader->imagedescriptor & 0x10);
-    bool flip_vertical   = (pHeader->imagedescriptor & 0x20);
-
-    uint32_t bytes_per_pixel = pHeader->bitsperpixel / 8;
-    uint32_t image_size      = id.width * id.height * bytes_per_pixel;
+    auto ext = file_name.size() >= 4 ? file_name.substr(file_name.size() - 4) : std::string{};
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
 
-    auto     img          = std::make_unique<uint8_t[]>(image_size);
-    uint32_t pixelcount   = id.height * id.width;
-    uint32_t currentpixel = 0;
-    uint32_t currentbyte  = 0;
+    if(ext == ".bmp")
+        return ReadBMP(file_name, id);
 
-    do
-    {
-        unsigned char chunk = static_cast<unsigned char>(pPtr[0]);
-        pPtr++;
-
-        if(chunk > 128)
-        {
-            chunk -= 127;
-            for(int32_t counter = 0; counter < chunk; counter++)
-            {
-                img[currentbyte + 0] = static_cast<uint8_t>(pPtr[2]);
-                img[currentbyte + 1] = static_cast<uint8_t>(pPtr[1]);
-                img[currentbyte + 2] = static_cast<uint8_t>(pPtr[0]);
-                if(id.type == ImageData::PixelType::pt_rgba)
-                    img[currentbyte + 3] = static_cast<uint8_t>(pPtr[3]);
-
-                currentbyte += bytes_per_pixel;
-                currentpixel++;
-
-                if(currentpixel > pixelcount)   // Make sure we havent written too many pixels
-                {
-                    return false;
-                }
-            }
-            pPtr += bytes_per_pixel;
-        }
-        else
-        {
-            chunk++;
-            for(short counter = 0; counter < chunk; counter++)
-            {
-                img[currentbyte + 0] = static_cast<uint8_t>(pPtr[2]);
-                img[currentbyte + 1] = static_cast<uint8_t>(pPtr[1]);
-                img[currentbyte + 2] = static_cast<uint8_t>(pPtr[0]);
-                if(id.type == ImageData::PixelType::pt_rgba)
-                    img[currentbyte + 3] = static_cast<uint8_t>(pPtr[3]);
-
-                currentbyte += bytes_per_pixel;
-                currentpixel++;
-                pPtr += bytes_per_pixel;
-
-                if(currentpixel > pixelcount)   // Make sure we havent read too many pixels
-                {
-                    return false;
-                }
-            }
-        }
-    } while(currentpixel < pixelcount);
-
-    if(flip_vertical)
-    {
-        auto flipped_img = std::make_unique<uint8_t[]>(image_size);
-
-        for(uint32_t i = 0; i < id.height; i++)
-        {
-            std::memcpy(flipped_img.get() + i * id.width * bytes_per_pixel,
-                        img.get() + (id.height - 1 - i) * id.width * bytes_per_pixel,
-                        id.width * bytes_per_pixel);
-        }
-
-        img = std::move(flipped_img);
-    }
-
-    if(flip_horizontal)
-    {
-        auto flipped_img = std::make_unique<uint8_t[]>(image_size);
-
-        for(uint32_t i = 0; i < id.height; i++)
-        {
-            for(uint32_t j = 0; j < id.width; j++)
-            {
-                flipped_img[id.width * bytes_per_pixel * i + j * bytes_per_pixel + 0] =
-                    img[id.width * bytes_per_pixel * i + (id.width - j - 1) * bytes_per_pixel + 0];
-                flipped_img[id.width * bytes_per_pixel * i + j * bytes_per_pixel + 1] =
-                    img[id.width * bytes_per_pixel * i + (id.width - j - 1) * bytes_per_pixel + 1];
-                flipped_img[id.width * bytes_per_pixel * i + j * bytes_per_pixel + 2] =
-                    img[id.width * bytes_per_pixel * i + (id.width - j - 1) * bytes_per_pixel + 2];
-                if(id.type == ImageData::PixelType::pt_rgba)
-                    flipped_img[id.width * bytes_per_pixel * i + j * bytes_per_pixel + 3] =
-                        img[id.width * bytes_per_pixel * i + (id.width - j - 1) * bytes_per_pixel + 3];
-            }
-        }
-
-        img = std::move(flipped_img);
-    }
-
-    id.data = std::move(img);
-    return true;
+    return ReadTGA(file_name, id);
 }
 }   // namespace tex
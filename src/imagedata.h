@@ -1,6 +1,7 @@
 #ifndef IMAGEDATA_H
 #define IMAGEDATA_H
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -25,7 +26,18 @@ struct ImageData
 
 bool ReadBMP(std::string const & file_name, ImageData & id);
 bool ReadTGA(std::string const & file_name, ImageData & id);
+// picks the reader by extension, anything but .bmp is read as TGA
+bool ReadImage(std::string const & file_name, ImageData & id);
+
+// Decode from memory. Headers, row strides and RLE packets are checked against size before
+// any pixel is read, so any input is safe to pass in, e.g. from a fuzzer.
+bool DecodeBMP(uint8_t const * data, size_t size, ImageData & id);
+bool DecodeTGA(uint8_t const * data, size_t size, ImageData & id);
 
 bool WriteTGA(std::string file_name, ImageData const & id);
+
+// Times the checked decoders against the unchecked ones they replaced on a BMP or TGA file.
+// Defined in imagedata_bench.cpp, which is only built with qmake CONFIG+=decode_bench.
+void DecodeBenchmark(std::string const & file_name, uint32_t iterations);
 }   // namespace evnt
 #endif   // IMAGEDATA_H
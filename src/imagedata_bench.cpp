@@ -0,0 +1,420 @@
+#include "imagedata.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// DecodeBenchmark and the unchecked readers it measures against. Only built with
+// qmake CONFIG+=decode_bench, it is not part of the loaders.
+
+namespace
+{
+#pragma pack(push, 1)
+struct BITMAPFILEHEADER
+{
+    uint16_t bfType;   // bmp file signature
+    uint32_t bfSize;   // file size
+    uint16_t bfReserved1;
+    uint16_t bfReserved2;
+    uint32_t bfOffBits;
+};
+
+struct BITMAPINFO12   // CORE version
+{
+    uint32_t biSize;
+    uint16_t biWidth;
+    uint16_t biHeight;
+    uint16_t biPlanes;
+    uint16_t biBitCount;
+};
+
+struct BITMAPINFO   // Standart version
+{
+    uint32_t biSize;
+    int32_t  biWidth;
+    int32_t  biHeight;
+    uint16_t biPlanes;
+    uint16_t biBitCount;
+    uint32_t biCompression;
+    uint32_t biSizeImage;
+    int32_t  biXPelsPerMeter;
+    int32_t  biYPelsPerMeter;
+    uint32_t biClrUsed;
+    uint32_t biClrImportant;
+};
+
+struct TGAHEADER
+{
+    uint8_t  idlength;
+    uint8_t  colourmaptype;
+    uint8_t  datatypecode;
+    uint16_t colourmaporigin;
+    uint16_t colourmaplength;
+    uint8_t  colourmapdepth;
+    uint16_t x_origin;
+    uint16_t y_origin;
+    uint16_t width;
+    uint16_t height;
+    uint8_t  bitsperpixel;
+    uint8_t  imagedescriptor;
+};
+#pragma pack(pop)
+
+using Clock = std::chrono::steady_clock;
+
+double ElapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+bool ReadFile(std::string const & file_name, std::vector<uint8_t> & file)
+{
+    std::ifstream ifile(file_name, std::ios::binary);
+    if(!ifile.is_open())
+        return false;
+
+    ifile.seekg(0, std::ios_base::end);
+    auto length = ifile.tellg();
+    ifile.seekg(0, std::ios_base::beg);
+
+    file.resize(static_cast<size_t>(length));
+
+    ifile.read(reinterpret_cast<char *>(file.data()), length);
+
+    auto success = !ifile.fail() && length == ifile.gcount();
+    ifile.close();
+
+    return success && !file.empty();
+}
+
+//==============================================================================
+//         Baseline decoders
+//==============================================================================
+// The readers as they were before the validation pass, minus the file I/O: header fields
+// are trusted and the RLE loop checks the pixel count per pixel. Kept only as the reference
+// DecodeBenchmark measures the checked decoders against; never use them on real input.
+void BaselineFlipTGA(std::unique_ptr<uint8_t[]> & img, tex::ImageData const & id, uint32_t bytes_per_pixel,
+                     uint32_t image_size, bool flip_horizontal, bool flip_vertical)
+{
+    if(flip_vertical)
+    {
+        auto flipped_img = std::make_unique<uint8_t[]>(image_size);
+
+        for(uint32_t i = 0; i < id.height; i++)
+        {
+            std::memcpy(flipped_img.get() + i * id.width * bytes_per_pixel,
+                        img.get() + (id.height - 1 - i) * id.width * bytes_per_pixel, id.width * bytes_per_pixel);
+        }
+
+        img = std::move(flipped_img);
+    }
+
+    if(flip_horizontal)
+    {
+        auto flipped_img = std::make_unique<uint8_t[]>(image_size);
+
+        for(uint32_t i = 0; i < id.height; i++)
+        {
+            for(uint32_t j = 0; j < id.width; j++)
+            {
+                flipped_img[id.width * bytes_per_pixel * i + j * bytes_per_pixel + 0] =
+                    img[id.width * bytes_per_pixel * i + (id.width - j - 1) * bytes_per_pixel + 0];
+                flipped_img[id.width * bytes_per_pixel * i + j * bytes_per_pixel + 1] =
+                    img[id.width * bytes_per_pixel * i + (id.width - j - 1) * bytes_per_pixel + 1];
+                flipped_img[id.width * bytes_per_pixel * i + j * bytes_per_pixel + 2] =
+                    img[id.width * bytes_per_pixel * i + (id.width - j - 1) * bytes_per_pixel + 2];
+                if(id.type == tex::ImageData::PixelType::pt_rgba)
+                    flipped_img[id.width * bytes_per_pixel * i + j * bytes_per_pixel + 3] =
+                        img[id.width * bytes_per_pixel * i + (id.width - j - 1) * bytes_per_pixel + 3];
+            }
+        }
+
+        img = std::move(flipped_img);
+    }
+}
+
+bool BaselineDecodeTGA(uint8_t const * data, tex::ImageData & id)
+{
+    TGAHEADER header;
+    std::memcpy(&header, data, sizeof(header));
+    auto const * pPtr = reinterpret_cast<char const *>(data) + sizeof(TGAHEADER);
+
+    if((header.width == 0) || (header.height == 0) || ((header.bitsperpixel != 24) && (header.bitsperpixel != 32))
+       || (header.datatypecode != 2 && header.datatypecode != 10))
+        return false;
+
+    id.width  = header.width;
+    id.height = header.height;
+    id.type = header.bitsperpixel == 24 ? tex::ImageData::PixelType::pt_rgb : tex::ImageData::PixelType::pt_rgba;
+    bool flip_horizontal = (header.imagedescriptor & 0x10);
+    bool flip_vertical   = (header.imagedescriptor & 0x20);
+
+    uint32_t bytes_per_pixel = header.bitsperpixel / 8u;
+    uint32_t image_size      = id.width * id.height * bytes_per_pixel;
+
+    // one spare pixel: the RLE loop writes a pixel before its count check can fire
+    auto img = std::make_unique<uint8_t[]>(image_size + bytes_per_pixel);
+
+    if(header.datatypecode == 2)
+    {
+        for(uint32_t i = 0; i < id.width * id.height; ++i)
+        {
+            char red, green, blue, alpha = 0;
+
+            red   = pPtr[i * bytes_per_pixel + 2];
+            green = pPtr[i * bytes_per_pixel + 1];
+            blue  = pPtr[i * bytes_per_pixel + 0];
+            if(id.type == tex::ImageData::PixelType::pt_rgba)
+                alpha = pPtr[i * bytes_per_pixel + 3];
+
+            img[i * bytes_per_pixel + 0] = static_cast<uint8_t>(red);
+            img[i * bytes_per_pixel + 1] = static_cast<uint8_t>(green);
+            img[i * bytes_per_pixel + 2] = static_cast<uint8_t>(blue);
+            if(id.type == tex::ImageData::PixelType::pt_rgba)
+                img[i * bytes_per_pixel + 3] = static_cast<uint8_t>(alpha);
+        }
+    }
+    else
+    {
+        uint32_t pixelcount   = id.height * id.width;
+        uint32_t currentpixel = 0;
+        uint32_t currentbyte  = 0;
+
+        do
+        {
+            unsigned char chunk = static_cast<unsigned char>(pPtr[0]);
+            pPtr++;
+
+            if(chunk > 128)
+            {
+                chunk -= 127;
+                for(int32_t counter = 0; counter < chunk; counter++)
+                {
+                    img[currentbyte + 0] = static_cast<uint8_t>(pPtr[2]);
+                    img[currentbyte + 1] = static_cast<uint8_t>(pPtr[1]);
+                    img[currentbyte + 2] = static_cast<uint8_t>(pPtr[0]);
+                    if(id.type == tex::ImageData::PixelType::pt_rgba)
+                        img[currentbyte + 3] = static_cast<uint8_t>(pPtr[3]);
+
+                    currentbyte += bytes_per_pixel;
+                    currentpixel++;
+
+                    if(currentpixel > pixelcount)
+                        return false;
+                }
+                pPtr += bytes_per_pixel;
+            }
+            else
+            {
+                chunk++;
+                for(short counter = 0; counter < chunk; counter++)
+                {
+                    img[currentbyte + 0] = static_cast<uint8_t>(pPtr[2]);
+                    img[currentbyte + 1] = static_cast<uint8_t>(pPtr[1]);
+                    img[currentbyte + 2] = static_cast<uint8_t>(pPtr[0]);
+                    if(id.type == tex::ImageData::PixelType::pt_rgba)
+                        img[currentbyte + 3] = static_cast<uint8_t>(pPtr[3]);
+
+                    currentbyte += bytes_per_pixel;
+                    currentpixel++;
+                    pPtr += bytes_per_pixel;
+
+                    if(currentpixel > pixelcount)
+                        return false;
+                }
+            }
+        } while(currentpixel < pixelcount);
+    }
+
+    BaselineFlipTGA(img, id, bytes_per_pixel, image_size, flip_horizontal, flip_vertical);
+
+    id.data = std::move(img);
+    return true;
+}
+
+bool BaselineDecodeBMP(uint8_t const * buffer, size_t file_length, tex::ImageData & id)
+{
+    bool compressed = false;
+    bool flip       = false;
+
+    BITMAPFILEHEADER header;
+    uint32_t         info_size;
+    std::memcpy(&header, buffer, sizeof(header));
+    std::memcpy(&info_size, buffer + sizeof(header), sizeof(info_size));
+    if(header.bfSize != file_length || header.bfType != 0x4D42)
+        return false;
+
+    if(info_size == 12)
+    {
+        BITMAPINFO12 info;
+        std::memcpy(&info, buffer + sizeof(header), sizeof(info));
+        if(info.biBitCount != 24 && info.biBitCount != 32)
+            return false;
+
+        id.type   = info.biBitCount == 24 ? tex::ImageData::PixelType::pt_rgb : tex::ImageData::PixelType::pt_rgba;
+        id.width  = info.biWidth;
+        id.height = info.biHeight;
+    }
+    else
+    {
+        BITMAPINFO info;
+        std::memcpy(&info, buffer + sizeof(header), sizeof(info));
+        if(info.biBitCount != 24 && info.biBitCount != 32)
+            return false;
+
+        if(info.biCompression != 3 && info.biCompression != 6 && info.biCompression != 0)
+            return false;
+
+        compressed = info.biCompression == 3 || info.biCompression == 6;
+        id.type    = info.biBitCount == 24 ? tex::ImageData::PixelType::pt_rgb : tex::ImageData::PixelType::pt_rgba;
+        id.width   = static_cast<uint32_t>(info.biWidth);
+        flip       = info.biHeight < 0;
+        id.height  = static_cast<uint32_t>(std::abs(info.biHeight));
+    }
+
+    uint8_t const * pPtr            = buffer + header.bfOffBits;
+    uint32_t        lineLength      = 0;
+    uint32_t        bytes_per_pixel = (id.type == tex::ImageData::PixelType::pt_rgb ? 3 : 4);
+    auto            image           = std::make_unique<uint8_t[]>(id.width * id.height * bytes_per_pixel);
+    uint8_t         red, green, blue, alpha = 0;
+    uint32_t        w_ind(0), h_ind(0);
+
+    if(id.type == tex::ImageData::PixelType::pt_rgb)
+        lineLength = id.width * bytes_per_pixel + id.width % 4;
+    else
+        lineLength = id.width * bytes_per_pixel;
+
+    for(uint32_t i = 0; i < id.height; ++i)
+    {
+        w_ind = 0;
+        for(uint32_t j = 0; j < lineLength; j += bytes_per_pixel)
+        {
+            // the original tested j > width * bpp and wrote one pixel past each padded row
+            if(j >= id.width * bytes_per_pixel)
+                continue;
+
+            if(compressed)
+            {
+                uint32_t count = 0;
+                if(id.type == tex::ImageData::PixelType::pt_rgba)
+                {
+                    alpha = pPtr[i * lineLength + j + count];
+                    count++;
+                }
+                blue = pPtr[i * lineLength + j + count];
+                count++;
+                green = pPtr[i * lineLength + j + count];
+                count++;
+                red = pPtr[i * lineLength + j + count];
+            }
+            else
+            {
+                blue  = pPtr[i * lineLength + j + 0];
+                green = pPtr[i * lineLength + j + 1];
+                red   = pPtr[i * lineLength + j + 2];
+                if(id.type == tex::ImageData::PixelType::pt_rgba)
+                    alpha = pPtr[i * lineLength + j + 3];
+            }
+
+            image[h_ind * id.width * bytes_per_pixel + w_ind * bytes_per_pixel + 0] = red;
+            image[h_ind * id.width * bytes_per_pixel + w_ind * bytes_per_pixel + 1] = green;
+            image[h_ind * id.width * bytes_per_pixel + w_ind * bytes_per_pixel + 2] = blue;
+            if(id.type == tex::ImageData::PixelType::pt_rgba)
+                image[h_ind * id.width * bytes_per_pixel + w_ind * bytes_per_pixel + 3] = alpha;
+            w_ind++;
+        }
+        h_ind++;
+    }
+
+    if(flip)
+    {
+        auto temp_buf = std::make_unique<uint8_t[]>(id.width * id.height * bytes_per_pixel);
+
+        for(uint32_t i = 0; i < id.height; i++)
+        {
+            std::memcpy(temp_buf.get() + i * id.width * bytes_per_pixel,
+                        image.get() + (id.height - 1 - i) * id.width * bytes_per_pixel, id.width * bytes_per_pixel);
+        }
+
+        image = std::move(temp_buf);
+    }
+
+    id.data = std::move(image);
+    return true;
+}
+}   // namespace
+
+namespace tex
+{
+//==============================================================================
+//         Benchmark
+//==============================================================================
+void DecodeBenchmark(std::string const & file_name, uint32_t iterations)
+{
+    std::vector<uint8_t> file;
+    if(iterations == 0 || !ReadFile(file_name, file))
+    {
+        std::cout << "Can't read " << file_name << std::endl;
+        return;
+    }
+
+    uint8_t const * data = file.data();
+    size_t const    size = file.size();
+
+    // only inputs the checked path accepts are handed to the unchecked one
+    ImageData  id;
+    bool const is_bmp = DecodeBMP(data, size, id);
+    if(!is_bmp && !DecodeTGA(data, size, id))
+    {
+        std::cout << file_name << " is not a supported BMP or TGA image" << std::endl;
+        return;
+    }
+
+    TGAHEADER tga_header;
+    std::memcpy(&tga_header, data, sizeof(tga_header));
+    if(!is_bmp && (tga_header.idlength != 0 || tga_header.colourmaptype == 1))
+    {
+        std::cout << file_name << " has an image ID or colour map the baseline decoder can't skip" << std::endl;
+        return;
+    }
+
+    // the baseline takes an RLE header of 128 as 129 raw pixels and can read past the end
+    std::vector<uint8_t> padded(file);
+    padded.resize(file.size() + 129 * 4 + 1, 0);
+
+    // every pass decodes into a fresh image, as the loaders do
+    auto time_ms = [iterations](auto && decode) {
+        auto start = Clock::now();
+        for(uint32_t it = 0; it < iterations; ++it)
+        {
+            ImageData image;
+            decode(image);
+        }
+        return ElapsedMs(start) / iterations;
+    };
+
+    // alternate the two a few times so neither profits from a warmer cache or allocator
+    double unchecked_ms = 0.0, checked_ms = 0.0;
+    for(int round = 0; round < 3; ++round)
+    {
+        unchecked_ms += time_ms([&](ImageData & image) {
+            is_bmp ? BaselineDecodeBMP(padded.data(), size, image) : BaselineDecodeTGA(padded.data(), image);
+        });
+        checked_ms += time_ms(
+            [&](ImageData & image) { is_bmp ? DecodeBMP(data, size, image) : DecodeTGA(data, size, image); });
+    }
+    unchecked_ms /= 3.0;
+    checked_ms /= 3.0;
+
+    std::cout << "Decoding " << file_name << " (" << id.width << "x" << id.height << ", " << size << " bytes), "
+              << iterations << " iterations" << std::endl;
+    std::cout << std::fixed << std::setprecision(4) << "  unchecked (baseline): " << unchecked_ms << " ms"
+              << std::endl;
+    std::cout << "  checked:              " << checked_ms << " ms, " << std::setprecision(1)
+              << static_cast<double>(size) / 1048576.0 / (checked_ms / 1000.0) << " MB/s" << std::endl;
+    std::cout << "  overhead:             " << std::showpos << std::setprecision(2)
+              << 100.0 * (checked_ms - unchecked_ms) / unchecked_ms << std::noshowpos << " %" << std::endl;
+}
+}   // namespace tex
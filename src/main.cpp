@@ -1,15 +1,49 @@
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 #include "window.h"
 
-int main(void)
+int main(int argc, char * argv[])
 {
+    // glfw_wrecreate --cull-bench [objects]
+    if(argc > 1 && std::strcmp(argv[1], "--cull-bench") == 0)
+    {
+        auto count = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 100000u;
+
+        // same camera as Window::initScene
+        glm::mat4 Projection = glm::perspective(45.0f, 4.0f / 3.0f, 0.1f, 100.0f);
+        glm::mat4 View       = glm::lookAt(glm::vec3(4, 3, 3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+        cull::Benchmark(Projection * View, count, 100);
+        return 0;
+    }
+
+#ifdef DECODE_BENCH
+    // glfw_wrecreate --decode-bench file [iterations]
+    if(argc > 2 && std::strcmp(argv[1], "--decode-bench") == 0)
+    {
+        auto iterations = argc > 3 ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10)) : 100u;
+        tex::DecodeBenchmark(argv[2], iterations);
+        return 0;
+    }
+#endif
+
+    // glfw_wrecreate --loader-test [file], exit code 0 if the uploaded texture reads back unchanged
+    if(argc > 1 && std::strcmp(argv[1], "--loader-test") == 0)
+        return AsyncLoaderTest(argc > 2 ? argv[2] : "uvtemplate.tga") ? 0 : 1;
+
+    // glfw_wrecreate --profile-frames frames
+    // renders a fixed number of frames and writes frame_profile.csv/.json, no key press needed
+    uint32_t max_frames{0};
+    if(argc > 2 && std::strcmp(argv[1], "--profile-frames") == 0)
+        max_frames = static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10));
+
     try
     {
         Window w{800, 600, "Sample"};
         w.create();
         w.initScene();
-        w.run();
+        w.run(max_frames);
     }
     catch(const std::exception & e)
     {
@@ -0,0 +1,622 @@
+#include "mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+
+#ifndef _WIN32
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace
+{
+constexpr char     mesh_magic[4] = {'M', 'S', 'H', '1'};
+constexpr uint32_t mesh_version  = 1;
+
+static_assert(sizeof(mesh::MeshHeader) == 72, "MeshHeader layout is part of the file format");
+
+uint64_t Align16(uint64_t value)
+{
+    return (value + 15) & ~uint64_t{15};
+}
+
+uint16_t HalfFromFloat(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign     = (bits >> 16) & 0x8000;
+    uint32_t raw_exp  = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    int32_t  exponent = static_cast<int32_t>(raw_exp) - 127 + 15;
+
+    if(raw_exp == 0xFF)   // inf or nan
+        return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    if(exponent >= 31)   // overflow
+        return static_cast<uint16_t>(sign | 0x7C00);
+    if(exponent <= 0)   // denormal or zero
+    {
+        if(exponent < -10)
+            return static_cast<uint16_t>(sign);
+
+        mantissa |= 0x800000;
+        auto     shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half  = mantissa >> shift;
+        if((mantissa >> (shift - 1)) & 1)
+            ++half;
+
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    if(mantissa & 0x1000)   // round, a carry into the exponent is still correct
+        ++half;
+
+    return static_cast<uint16_t>(half);
+}
+
+struct VertexKey
+{
+    uint32_t bits[5];
+
+    bool operator==(VertexKey const & other) const { return std::memcmp(bits, other.bits, sizeof(bits)) == 0; }
+};
+
+struct VertexKeyHash
+{
+    size_t operator()(VertexKey const & key) const
+    {
+        size_t h = 0;
+        for(uint32_t b : key.bits)
+            h = h * 31 + b;
+        return h;
+    }
+};
+
+// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+float VertexScore(int32_t cache_pos, uint32_t remaining, uint32_t cache_size)
+{
+    if(remaining == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if(cache_pos >= 0)
+    {
+        // the last triangle's vertices get a fixed score so the strip doesn't turn back
+        if(cache_pos < 3)
+            score = 0.75f;
+        else
+            score = std::pow(1.0f - static_cast<float>(cache_pos - 3) / static_cast<float>(cache_size - 3), 1.5f);
+    }
+
+    // favour vertices with few triangles left, to finish them off
+    score += 2.0f / std::sqrt(static_cast<float>(remaining));
+
+    return score;
+}
+
+std::vector<uint32_t> OptimizeTriangleOrder(std::vector<uint32_t> const & indices, uint32_t vertex_count,
+                                            uint32_t cache_size)
+{
+    auto const tri_count = static_cast<uint32_t>(indices.size() / 3);
+    uint32_t const none  = std::numeric_limits<uint32_t>::max();
+
+    // vertex -> triangle adjacency
+    std::vector<uint32_t> adj_offset(vertex_count + 1, 0);
+    std::vector<uint32_t> adj(indices.size());
+    for(uint32_t idx : indices)
+        ++adj_offset[idx + 1];
+    for(uint32_t v = 0; v < vertex_count; ++v)
+        adj_offset[v + 1] += adj_offset[v];
+
+    std::vector<uint32_t> cursor(adj_offset.begin(), adj_offset.end() - 1);
+    for(uint32_t i = 0; i < indices.size(); ++i)
+        adj[cursor[indices[i]]++] = i / 3;
+
+    std::vector<uint32_t> remaining(vertex_count);
+    std::vector<int32_t>  cache_pos(vertex_count, -1);
+    std::vector<float>    vscore(vertex_count);
+    for(uint32_t v = 0; v < vertex_count; ++v)
+    {
+        remaining[v] = adj_offset[v + 1] - adj_offset[v];
+        vscore[v]    = VertexScore(-1, remaining[v], cache_size);
+    }
+
+    std::vector<float> tscore(tri_count);
+    std::vector<bool>  emitted(tri_count, false);
+    uint32_t           best = none;
+    float              best_score = -1.0f;
+    for(uint32_t t = 0; t < tri_count; ++t)
+    {
+        tscore[t] = vscore[indices[t * 3]] + vscore[indices[t * 3 + 1]] + vscore[indices[t * 3 + 2]];
+        if(tscore[t] > best_score)
+        {
+            best_score = tscore[t];
+            best       = t;
+        }
+    }
+
+    std::vector<uint32_t> out;
+    out.reserve(indices.size());
+    std::vector<uint32_t> cache, new_cache;
+    uint32_t              scan = 0;
+
+    for(uint32_t n = 0; n < tri_count; ++n)
+    {
+        if(best == none)
+        {
+            // nothing in the cache touches an open triangle, restart from the next one in order
+            while(emitted[scan])
+                ++scan;
+            best = scan;
+        }
+
+        emitted[best] = true;
+        new_cache.clear();
+        for(uint32_t k = 0; k < 3; ++k)
+        {
+            uint32_t v = indices[best * 3 + k];
+            out.push_back(v);
+            --remaining[v];
+            new_cache.push_back(v);
+        }
+        for(uint32_t v : cache)
+        {
+            if(std::find(new_cache.begin(), new_cache.begin() + 3, v) == new_cache.begin() + 3)
+                new_cache.push_back(v);
+        }
+
+        for(uint32_t i = 0; i < new_cache.size(); ++i)
+        {
+            uint32_t v   = new_cache[i];
+            cache_pos[v] = i < cache_size ? static_cast<int32_t>(i) : -1;
+            vscore[v]    = VertexScore(cache_pos[v], remaining[v], cache_size);
+        }
+
+        // rescore the open triangles around the cache, including the vertices just evicted
+        best       = none;
+        best_score = -1.0f;
+        for(uint32_t v : new_cache)
+        {
+            for(uint32_t a = adj_offset[v]; a < adj_offset[v + 1]; ++a)
+            {
+                uint32_t t = adj[a];
+                if(emitted[t])
+                    continue;
+
+                tscore[t] = vscore[indices[t * 3]] + vscore[indices[t * 3 + 1]] + vscore[indices[t * 3 + 2]];
+                if(tscore[t] > best_score)
+                {
+                    best_score = tscore[t];
+                    best       = t;
+                }
+            }
+        }
+
+        if(new_cache.size() > cache_size)
+            new_cache.resize(cache_size);
+        cache.swap(new_cache);
+    }
+
+    return out;
+}
+
+// Checks a cooked mesh before it is uploaded: the header, that the vertex layout matches
+// the formats, that both blocks lie inside the file and that every index is in range
+bool ValidateMesh(uint8_t const * data, size_t size)
+{
+    mesh::MeshHeader const * h = reinterpret_cast<mesh::MeshHeader const *>(data);
+    if(std::memcmp(h->magic, mesh_magic, sizeof(mesh_magic)) != 0 || h->version != mesh_version
+       || (h->index_size != 2 && h->index_size != 4) || h->position_format > 2 || h->texcoord_format > 1)
+        return false;
+
+    uint32_t position_bytes = h->position_format == static_cast<uint8_t>(mesh::PositionFormat::pf_float) ? 12 : 8;
+    uint32_t texcoord_bytes = h->texcoord_format == static_cast<uint8_t>(mesh::TexCoordFormat::tf_float) ? 8 : 4;
+    if(h->texcoord_offset != position_bytes || h->stride != position_bytes + texcoord_bytes)
+        return false;
+
+    // divisions instead of end offsets, a crafted offset or count must not wrap around
+    if(h->vertex_data_offset % 16 != 0 || h->index_data_offset % 16 != 0 || h->vertex_data_offset > size
+       || h->index_data_offset > size || h->vertex_count > (size - h->vertex_data_offset) / h->stride
+       || h->index_count > (size - h->index_data_offset) / h->index_size || h->index_count % 3 != 0)
+        return false;
+
+    uint8_t const * indices   = data + h->index_data_offset;
+    uint32_t        max_index = 0;
+    if(h->index_size == 2)
+    {
+        for(uint32_t i = 0; i < h->index_count; ++i)
+        {
+            uint16_t index;
+            std::memcpy(&index, indices + i * 2, 2);
+            max_index = std::max<uint32_t>(max_index, index);
+        }
+    }
+    else
+    {
+        for(uint32_t i = 0; i < h->index_count; ++i)
+        {
+            uint32_t index;
+            std::memcpy(&index, indices + static_cast<size_t>(i) * 4, 4);
+            max_index = std::max(max_index, index);
+        }
+    }
+
+    return h->index_count == 0 || max_index < h->vertex_count;
+}
+}   // namespace
+
+namespace mesh
+{
+uint32_t SimulateVertexCache(std::vector<uint32_t> const & indices, uint32_t cache_size)
+{
+    std::deque<uint32_t> fifo;
+    uint32_t             misses = 0;
+
+    for(uint32_t idx : indices)
+    {
+        if(std::find(fifo.begin(), fifo.end(), idx) != fifo.end())
+            continue;
+
+        ++misses;
+        fifo.push_back(idx);
+        if(fifo.size() > cache_size)
+            fifo.pop_front();
+    }
+
+    return misses;
+}
+
+bool BuildMesh(float const * positions, float const * uvs, uint32_t vertex_count, MeshOptions const & opt,
+               MeshData & md, MeshStats * stats)
+{
+    if(positions == nullptr || uvs == nullptr || vertex_count == 0 || vertex_count % 3 != 0 || opt.cache_size < 4)
+        return false;
+
+    // deduplicate identical position/uv pairs
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> lookup;
+    std::vector<uint32_t>                                  source_of;   // unique vertex -> source vertex
+    std::vector<uint32_t>                                  indices(vertex_count);
+
+    for(uint32_t i = 0; i < vertex_count; ++i)
+    {
+        VertexKey key;
+        std::memcpy(key.bits, positions + i * 3, 3 * sizeof(float));
+        std::memcpy(key.bits + 3, uvs + i * 2, 2 * sizeof(float));
+
+        auto it = lookup.find(key);
+        if(it == lookup.end())
+        {
+            it = lookup.emplace(key, static_cast<uint32_t>(source_of.size())).first;
+            source_of.push_back(i);
+        }
+        indices[i] = it->second;
+    }
+
+    auto unique_count = static_cast<uint32_t>(source_of.size());
+    auto optimized    = OptimizeTriangleOrder(indices, unique_count, opt.cache_size);
+
+    // renumber vertices in order of first use for fetch locality
+    std::vector<uint32_t> remap(unique_count, std::numeric_limits<uint32_t>::max());
+    std::vector<uint32_t> order;
+    order.reserve(unique_count);
+    for(uint32_t & idx : optimized)
+    {
+        if(remap[idx] == std::numeric_limits<uint32_t>::max())
+        {
+            remap[idx] = static_cast<uint32_t>(order.size());
+            order.push_back(source_of[idx]);
+        }
+        idx = remap[idx];
+    }
+
+    // bounds for snorm16 quantization
+    glm::vec3 lo{std::numeric_limits<float>::max()}, hi{-std::numeric_limits<float>::max()};
+    for(uint32_t src : order)
+    {
+        for(int c = 0; c < 3; ++c)
+        {
+            lo[c] = std::min(lo[c], positions[src * 3 + static_cast<uint32_t>(c)]);
+            hi[c] = std::max(hi[c], positions[src * 3 + static_cast<uint32_t>(c)]);
+        }
+    }
+
+    MeshHeader & h = md.header;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, mesh_magic, sizeof(h.magic));
+    h.version         = mesh_version;
+    h.vertex_count    = unique_count;
+    h.index_count     = vertex_count;
+    h.position_format = static_cast<uint8_t>(opt.position_format);
+    h.texcoord_format = static_cast<uint8_t>(opt.texcoord_format);
+    h.index_size      = unique_count <= 0xFFFF ? 2 : 4;
+
+    uint32_t position_bytes = opt.position_format == PositionFormat::pf_float ? 12 : 8;
+    uint32_t texcoord_bytes = opt.texcoord_format == TexCoordFormat::tf_float ? 8 : 4;
+    h.texcoord_offset       = position_bytes;
+    h.stride                = position_bytes + texcoord_bytes;
+
+    for(int c = 0; c < 3; ++c)
+    {
+        h.position_scale[c]  = 1.0f;
+        h.position_offset[c] = 0.0f;
+        if(opt.position_format == PositionFormat::pf_snorm16)
+        {
+            float half_extent    = (hi[c] - lo[c]) * 0.5f;
+            h.position_offset[c] = (hi[c] + lo[c]) * 0.5f;
+            h.position_scale[c]  = half_extent > 0.0f ? half_extent / 32767.0f : 1.0f;
+        }
+    }
+
+    // interleave
+    md.vertices.assign(static_cast<size_t>(unique_count) * h.stride, 0);
+    for(uint32_t v = 0; v < unique_count; ++v)
+    {
+        uint8_t *     dst = md.vertices.data() + static_cast<size_t>(v) * h.stride;
+        float const * p   = positions + order[v] * 3;
+        float const * uv  = uvs + order[v] * 2;
+
+        switch(opt.position_format)
+        {
+            case PositionFormat::pf_float:
+                std::memcpy(dst, p, 12);
+                break;
+            case PositionFormat::pf_half:
+                for(int c = 0; c < 3; ++c)
+                {
+                    uint16_t q = HalfFromFloat(p[c]);
+                    std::memcpy(dst + c * 2, &q, 2);
+                }
+                break;
+            case PositionFormat::pf_snorm16:
+                for(int c = 0; c < 3; ++c)
+                {
+                    float f = std::round((p[c] - h.position_offset[c]) / h.position_scale[c]);
+                    auto  q = static_cast<int16_t>(std::max(-32767.0f, std::min(32767.0f, f)));
+                    std::memcpy(dst + c * 2, &q, 2);
+                }
+                break;
+        }
+
+        dst += h.texcoord_offset;
+        if(opt.texcoord_format == TexCoordFormat::tf_float)
+        {
+            std::memcpy(dst, uv, 8);
+        }
+        else
+        {
+            for(int c = 0; c < 2; ++c)
+            {
+                uint16_t q = HalfFromFloat(uv[c]);
+                std::memcpy(dst + c * 2, &q, 2);
+            }
+        }
+    }
+
+    md.indices.resize(static_cast<size_t>(vertex_count) * h.index_size);
+    for(uint32_t i = 0; i < vertex_count; ++i)
+    {
+        if(h.index_size == 2)
+        {
+            auto idx = static_cast<uint16_t>(optimized[i]);
+            std::memcpy(md.indices.data() + i * 2, &idx, 2);
+        }
+        else
+        {
+            std::memcpy(md.indices.data() + i * 4, &optimized[i], 4);
+        }
+    }
+
+    h.vertex_data_offset = Align16(sizeof(MeshHeader));
+    h.index_data_offset  = Align16(h.vertex_data_offset + md.vertices.size());
+
+    if(stats != nullptr)
+    {
+        stats->source_vertices       = vertex_count;
+        stats->unique_vertices       = unique_count;
+        stats->triangles             = vertex_count / 3;
+        stats->source_bytes          = vertex_count * 5 * static_cast<uint32_t>(sizeof(float));
+        stats->vertex_bytes          = static_cast<uint32_t>(md.vertices.size());
+        stats->index_bytes           = static_cast<uint32_t>(md.indices.size());
+        stats->invocations_indexed   = SimulateVertexCache(indices, opt.cache_size);
+        stats->invocations_optimized = SimulateVertexCache(optimized, opt.cache_size);
+    }
+
+    return true;
+}
+
+bool WriteMesh(std::string const & file_name, MeshData const & md)
+{
+    std::ofstream ofile(file_name, std::ios::binary);
+    if(!ofile.is_open())
+        return false;
+
+    char const zeros[16] = {};
+    auto       pad_to    = [&](uint64_t offset) {
+        auto pos = static_cast<uint64_t>(ofile.tellp());
+        ofile.write(zeros, static_cast<std::streamsize>(offset - pos));
+    };
+
+    ofile.write(reinterpret_cast<char const *>(&md.header), sizeof(md.header));
+    pad_to(md.header.vertex_data_offset);
+    ofile.write(reinterpret_cast<char const *>(md.vertices.data()), static_cast<std::streamsize>(md.vertices.size()));
+    pad_to(md.header.index_data_offset);
+    ofile.write(reinterpret_cast<char const *>(md.indices.data()), static_cast<std::streamsize>(md.indices.size()));
+    ofile.close();
+
+    return !ofile.fail();
+}
+
+//==============================================================================
+//         MappedMesh
+//==============================================================================
+MappedMesh::MappedMesh() : mp_data{nullptr}, m_size{0}, m_mapped{false} {}
+
+MappedMesh::~MappedMesh()
+{
+    close();
+}
+
+bool MappedMesh::open(std::string const & file_name)
+{
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(file_name.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(MeshHeader)))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    m_size     = static_cast<size_t>(st.st_size);
+    void * ptr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if(ptr == MAP_FAILED)
+    {
+        m_size = 0;
+        return false;
+    }
+
+    mp_data  = ptr;
+    m_mapped = true;
+#else
+    std::ifstream ifile(file_name, std::ios::binary);
+    if(!ifile.is_open())
+        return false;
+
+    ifile.seekg(0, std::ios_base::end);
+    auto length = ifile.tellg();
+    ifile.seekg(0, std::ios_base::beg);
+    if(length < static_cast<std::streamoff>(sizeof(MeshHeader)))
+        return false;
+
+    m_size  = static_cast<size_t>(length);
+    mp_data = new uint8_t[m_size];
+    ifile.read(static_cast<char *>(mp_data), length);
+    if(ifile.fail())
+    {
+        close();
+        return false;
+    }
+#endif
+
+    // the payload goes to glDrawElements as is, nothing in it may point outside the buffers
+    if(!ValidateMesh(static_cast<uint8_t const *>(mp_data), m_size))
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedMesh::close()
+{
+    if(mp_data == nullptr)
+        return;
+
+#ifndef _WIN32
+    if(m_mapped)
+        munmap(mp_data, m_size);
+#else
+    delete[] static_cast<uint8_t *>(mp_data);
+#endif
+
+    mp_data  = nullptr;
+    m_size   = 0;
+    m_mapped = false;
+}
+
+//==============================================================================
+//         GPU upload
+//==============================================================================
+namespace
+{
+bool UploadMeshData(MeshHeader const * h, uint8_t const * vertices, uint8_t const * indices, Mesh & mesh)
+{
+    auto position_format = static_cast<PositionFormat>(h->position_format);
+    auto texcoord_format = static_cast<TexCoordFormat>(h->texcoord_format);
+    if((position_format == PositionFormat::pf_half || texcoord_format == TexCoordFormat::tf_half)
+       && !GLEW_ARB_half_float_vertex)
+        return false;
+
+    ReleaseMesh(mesh);
+
+    glGenBuffers(1, &mesh.vertex_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(h->vertex_count) * h->stride, vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenBuffers(1, &mesh.index_buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.index_buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(h->index_count) * h->index_size,
+                 indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    switch(position_format)
+    {
+        case PositionFormat::pf_float:
+            mesh.position_type = GL_FLOAT;
+            break;
+        case PositionFormat::pf_half:
+            mesh.position_type = GL_HALF_FLOAT;
+            break;
+        case PositionFormat::pf_snorm16:
+            mesh.position_type = GL_SHORT;
+            break;
+    }
+    mesh.position_size   = 3;
+    mesh.texcoord_type   = texcoord_format == TexCoordFormat::tf_half ? GL_HALF_FLOAT : GL_FLOAT;
+    mesh.stride          = static_cast<GLsizei>(h->stride);
+    mesh.texcoord_offset = h->texcoord_offset;
+    mesh.index_type      = h->index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    mesh.index_count     = static_cast<GLsizei>(h->index_count);
+
+    // fixed function has no normalized positions, the scale and bias go into the matrix
+    mesh.dequantize       = glm::mat4(1.0f);
+    mesh.dequantize[0][0] = h->position_scale[0];
+    mesh.dequantize[1][1] = h->position_scale[1];
+    mesh.dequantize[2][2] = h->position_scale[2];
+    mesh.dequantize[3]    = glm::vec4(h->position_offset[0], h->position_offset[1], h->position_offset[2], 1.0f);
+
+    return true;
+}
+}   // namespace
+
+bool UploadMesh(MappedMesh const & mapped, Mesh & mesh)
+{
+    if(mapped.header() == nullptr)
+        return false;
+
+    return UploadMeshData(mapped.header(), mapped.vertexData(), mapped.indexData(), mesh);
+}
+
+bool UploadMesh(MeshData const & md, Mesh & mesh)
+{
+    return UploadMeshData(&md.header, md.vertices.data(), md.indices.data(), mesh);
+}
+
+void ReleaseMesh(Mesh & mesh)
+{
+    if(mesh.vertex_buffer != 0)
+        glDeleteBuffers(1, &mesh.vertex_buffer);
+    if(mesh.index_buffer != 0)
+        glDeleteBuffers(1, &mesh.index_buffer);
+
+    mesh.vertex_buffer = 0;
+    mesh.index_buffer  = 0;
+    mesh.index_count   = 0;
+}
+}   // namespace mesh
@@ -0,0 +1,131 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Include GLEW
+#include <GL/glew.h>
+// Include GLM
+#include <glm/glm.hpp>
+
+namespace mesh
+{
+enum class PositionFormat : uint8_t
+{
+    pf_float,     // 3 x float
+    pf_half,      // 3 x half float, padded to 8 bytes
+    pf_snorm16    // 3 x short scaled to the mesh bounds, padded to 8 bytes
+};
+
+enum class TexCoordFormat : uint8_t
+{
+    tf_float,   // 2 x float
+    tf_half     // 2 x half float
+};
+
+struct MeshOptions
+{
+    PositionFormat position_format = PositionFormat::pf_float;
+    TexCoordFormat texcoord_format = TexCoordFormat::tf_float;
+    uint32_t       cache_size      = 32;   // post-transform cache size the triangles are ordered for
+};
+
+struct MeshStats
+{
+    uint32_t source_vertices       = 0;   // non-indexed input, also its vertex shader invocations
+    uint32_t unique_vertices       = 0;
+    uint32_t triangles             = 0;
+    uint32_t source_bytes          = 0;   // separate float position and uv arrays
+    uint32_t vertex_bytes          = 0;
+    uint32_t index_bytes           = 0;
+    uint32_t invocations_indexed   = 0;   // simulated FIFO cache misses before reordering
+    uint32_t invocations_optimized = 0;   // ... and after
+};
+
+// Cooked mesh file: this header, interleaved vertices and indices, each block 16-byte aligned.
+// All offsets are relative to the start of the file so the data can be uploaded straight
+// from a memory mapping.
+struct MeshHeader
+{
+    char     magic[4];   // "MSH1"
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t stride;
+    uint8_t  position_format;
+    uint8_t  texcoord_format;
+    uint8_t  index_size;   // 2 or 4 bytes
+    uint8_t  reserved;
+    uint32_t texcoord_offset;
+    uint64_t vertex_data_offset;
+    uint64_t index_data_offset;
+    float    position_scale[3];    // dequantization: p = q * scale + offset
+    float    position_offset[3];
+};
+
+struct MeshData
+{
+    MeshHeader           header{};
+    std::vector<uint8_t> vertices;
+    std::vector<uint8_t> indices;
+};
+
+// Read-only view of a cooked mesh file, memory mapped where the platform allows it
+class MappedMesh
+{
+    void * mp_data;
+    size_t m_size;
+    bool   m_mapped;
+
+public:
+    MappedMesh();
+    ~MappedMesh();
+
+    MappedMesh(const MappedMesh &) = delete;
+    MappedMesh & operator=(const MappedMesh &) = delete;
+
+    bool open(std::string const & file_name);
+    void close();
+
+    MeshHeader const * header() const { return static_cast<MeshHeader const *>(mp_data); }
+    uint8_t const *    vertexData() const
+    {
+        return static_cast<uint8_t const *>(mp_data) + header()->vertex_data_offset;
+    }
+    uint8_t const * indexData() const { return static_cast<uint8_t const *>(mp_data) + header()->index_data_offset; }
+};
+
+// GPU side of a mesh and the vertex layout needed to draw it
+struct Mesh
+{
+    GLuint    vertex_buffer   = 0;
+    GLuint    index_buffer    = 0;
+    GLint     position_size   = 3;
+    GLenum    position_type   = GL_FLOAT;
+    GLenum    texcoord_type   = GL_FLOAT;
+    GLsizei   stride          = 0;
+    size_t    texcoord_offset = 0;
+    GLenum    index_type      = GL_UNSIGNED_SHORT;
+    GLsizei   index_count     = 0;
+    glm::mat4 dequantize{1.0f};   // folded into the model-view matrix
+};
+
+// Deduplicates a non-indexed triangle list of float xyz positions and uv pairs, orders the
+// triangles for the post-transform vertex cache and the vertices for fetch locality, and
+// encodes the interleaved vertex format.
+bool BuildMesh(float const * positions, float const * uvs, uint32_t vertex_count, MeshOptions const & opt,
+               MeshData & md, MeshStats * stats = nullptr);
+bool WriteMesh(std::string const & file_name, MeshData const & md);
+
+// the binds go around GLStateCache, invalidate it afterwards
+bool UploadMesh(MappedMesh const & mapped, Mesh & mesh);
+bool UploadMesh(MeshData const & md, Mesh & mesh);
+void ReleaseMesh(Mesh & mesh);
+
+// number of vertex shader invocations for an index list with a FIFO post-transform cache
+uint32_t SimulateVertexCache(std::vector<uint32_t> const & indices, uint32_t cache_size);
+}   // namespace mesh
+#endif   // MESH_H
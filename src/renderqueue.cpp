@@ -0,0 +1,106 @@
+#include "renderqueue.h"
+#include "glstate.h"
+#include "mesh.h"
+#include <array>
+#include <cstring>
+
+uint64_t RenderQueue::makeKey(RenderCommand const & cmd, float view_depth)
+{
+    // the bit pattern of a non-negative float orders like the value itself
+    float    depth = view_depth > 0.0f ? view_depth : 0.0f;
+    uint32_t depth_bits;
+    std::memcpy(&depth_bits, &depth, sizeof(depth_bits));
+
+    uint64_t layout = cmd.vao != 0 ? cmd.vao : (cmd.mesh != nullptr ? cmd.mesh->vertex_buffer : 0);
+
+    return (static_cast<uint64_t>(cmd.program & 0xFF) << 56) | (static_cast<uint64_t>(cmd.texture & 0xFFFF) << 40)
+           | ((layout & 0xFFFF) << 24) | (depth_bits >> 8);
+}
+
+void RenderQueue::clear()
+{
+    m_commands.clear();
+    m_transforms.clear();
+    m_items.clear();
+}
+
+void RenderQueue::submit(RenderCommand cmd, glm::mat4 const & model_view)
+{
+    // camera looks down -Z, so front-to-back is ascending -z of the object origin
+    float view_depth = -model_view[3][2];
+
+    cmd.transform = static_cast<uint32_t>(m_transforms.size());
+    m_transforms.push_back(cmd.mesh != nullptr ? model_view * cmd.mesh->dequantize : model_view);
+
+    m_items.push_back(SortItem{makeKey(cmd, view_depth), static_cast<uint32_t>(m_commands.size())});
+    m_commands.push_back(cmd);
+}
+
+void RenderQueue::sort()
+{
+    size_t const count = m_items.size();
+    if(count < 2)
+        return;
+
+    m_scratch.resize(count);
+
+    for(uint32_t shift = 0; shift < 64; shift += 8)
+    {
+        std::array<uint32_t, 256> histogram{};
+        for(auto const & item : m_items)
+            ++histogram[(item.key >> shift) & 0xFF];
+
+        // every key has the same digit, the pass would not move anything
+        if(histogram[(m_items[0].key >> shift) & 0xFF] == count)
+            continue;
+
+        uint32_t offset = 0;
+        for(auto & h : histogram)
+        {
+            uint32_t c = h;
+            h          = offset;
+            offset += c;
+        }
+
+        for(auto const & item : m_items)
+            m_scratch[histogram[(item.key >> shift) & 0xFF]++] = item;
+
+        m_items.swap(m_scratch);
+    }
+}
+
+void RenderQueue::execute(GLStateCache & state) const
+{
+    for(auto const & item : m_items)
+    {
+        auto const & cmd = m_commands[item.command];
+
+        state.useProgram(cmd.program);
+        state.bindTexture(cmd.texture);
+
+        if(cmd.mesh == nullptr)
+            continue;
+
+        // without vertex array objects the vao is meaningless, the mesh layout is set up instead
+        auto const & m = *cmd.mesh;
+        if(cmd.vao != 0 && state.hasVertexArrayObjects())
+        {
+            state.bindVertexArray(cmd.vao);
+        }
+        else
+        {
+            state.bindVertexArray(0);
+            state.enableVertexArray(true);
+            state.vertexPointer(m.vertex_buffer, m.position_size, m.position_type, m.stride, 0);
+            state.enableTexCoordArray(true);
+            state.texCoordPointer(m.vertex_buffer, 2, m.texcoord_type, m.stride, m.texcoord_offset);
+            state.bindElementBuffer(m.index_buffer);
+        }
+
+        state.loadModelView(m_transforms[cmd.transform]);
+
+        size_t index_size = m.index_type == GL_UNSIGNED_SHORT ? 2 : 4;
+        glDrawElements(cmd.mode, cmd.count, m.index_type,
+                       static_cast<char *>(nullptr) + static_cast<size_t>(cmd.first) * index_size);
+    }
+}
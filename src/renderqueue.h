@@ -0,0 +1,65 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Include GLEW
+#include <GL/glew.h>
+// Include GLM
+#include <glm/glm.hpp>
+
+class GLStateCache;
+
+namespace mesh
+{
+struct Mesh;
+}
+
+// One recorded indexed draw of count indices starting at first. The vertex layout comes from
+// the mesh; a non-zero vao is bound instead of setting the layout up through the pointers.
+// Where vertex array objects are not supported the vao is ignored and the mesh layout is used.
+struct RenderCommand
+{
+    GLuint             program   = 0;
+    GLuint             texture   = 0;
+    GLuint             vao       = 0;
+    mesh::Mesh const * mesh      = nullptr;
+    GLenum             mode      = GL_TRIANGLES;
+    GLint              first     = 0;
+    GLsizei            count     = 0;
+    uint32_t           transform = 0;   // index of the model-view matrix, set by RenderQueue
+};
+
+// Draws are recorded for the frame, ordered by a 64-bit sort key with an LSD radix sort
+// and executed through a GLStateCache, so consecutive draws sharing a program, texture or
+// vertex layout do not repeat the binds.
+class RenderQueue
+{
+    struct SortItem
+    {
+        uint64_t key;
+        uint32_t command;
+    };
+
+    std::vector<RenderCommand> m_commands;
+    std::vector<glm::mat4>     m_transforms;
+    std::vector<SortItem>      m_items;
+    std::vector<SortItem>      m_scratch;
+
+public:
+    // key layout, most significant first: program 8 | texture 16 | vertex layout 16 | depth 24;
+    // names wider than their field only weaken the grouping, never the correctness
+    static uint64_t makeKey(RenderCommand const & cmd, float view_depth);
+
+    void clear();
+    // the mesh dequantization matrix is applied here
+    void submit(RenderCommand cmd, glm::mat4 const & model_view);
+    void sort();
+    void execute(GLStateCache & state) const;
+
+    size_t size() const { return m_commands.size(); }
+};
+
+#endif   // RENDERQUEUE_H
@@ -0,0 +1,120 @@
+#include "spritebatch.h"
+#include "glstate.h"
+#include <algorithm>
+
+SpriteBatch::SpriteBatch() :
+    m_vertex_buffer{0},
+    m_index_buffer{0},
+    m_capacity{0},
+    mp_state{nullptr},
+    m_texture{0},
+    m_model_view{1.0f},
+    m_sprites{0},
+    m_draws{0}
+{}
+
+bool SpriteBatch::init(uint32_t max_sprites)
+{
+    release();
+
+    m_capacity = std::min(std::max(max_sprites, 1u), max_capacity);
+
+    // two triangles per quad, the vertices of quad q are 4q .. 4q + 3
+    std::vector<uint16_t> indices;
+    indices.reserve(static_cast<size_t>(m_capacity) * 6);
+    for(uint32_t q = 0; q < m_capacity; ++q)
+    {
+        for(uint32_t i : {0u, 1u, 2u, 0u, 2u, 3u})
+            indices.push_back(static_cast<uint16_t>(q * 4 + i));
+    }
+
+    glGenBuffers(1, &m_index_buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(uint16_t)), indices.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    glGenBuffers(1, &m_vertex_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_capacity * 4 * sizeof(Vertex)), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    m_vertices.reserve(static_cast<size_t>(m_capacity) * 4);
+
+    return m_index_buffer != 0 && m_vertex_buffer != 0;
+}
+
+void SpriteBatch::release()
+{
+    if(m_vertex_buffer != 0)
+        glDeleteBuffers(1, &m_vertex_buffer);
+    if(m_index_buffer != 0)
+        glDeleteBuffers(1, &m_index_buffer);
+
+    m_vertex_buffer = 0;
+    m_index_buffer  = 0;
+    m_capacity      = 0;
+    m_vertices.clear();
+}
+
+void SpriteBatch::begin(GLStateCache & state, GLuint atlas_texture, glm::mat4 const & model_view)
+{
+    flush();
+
+    mp_state     = &state;
+    m_texture    = atlas_texture;
+    m_model_view = model_view;
+}
+
+void SpriteBatch::add(tex::AtlasRegion const & region, float x, float y, float width, float height)
+{
+    if(mp_state == nullptr || m_capacity == 0)
+        return;
+
+    if(m_vertices.size() == static_cast<size_t>(m_capacity) * 4)
+        flush();
+
+    // counter-clockwise from the lower-left corner, v grows upwards like the atlas rows
+    m_vertices.push_back(Vertex{x, y, region.u0, region.v0});
+    m_vertices.push_back(Vertex{x + width, y, region.u1, region.v0});
+    m_vertices.push_back(Vertex{x + width, y + height, region.u1, region.v1});
+    m_vertices.push_back(Vertex{x, y + height, region.u0, region.v1});
+    ++m_sprites;
+}
+
+void SpriteBatch::end()
+{
+    flush();
+    mp_state = nullptr;
+}
+
+void SpriteBatch::flush()
+{
+    if(m_vertices.empty() || mp_state == nullptr)
+        return;
+
+    GLStateCache & state = *mp_state;
+
+    state.useProgram(0);
+    state.bindTexture(m_texture);
+    state.bindVertexArray(0);
+    state.bindArrayBuffer(m_vertex_buffer);
+
+    // orphan the previous contents so the driver doesn't wait for the last draw to finish
+    auto bytes = static_cast<GLsizeiptr>(m_vertices.size() * sizeof(Vertex));
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_capacity * 4 * sizeof(Vertex)), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, m_vertices.data());
+
+    state.enableVertexArray(true);
+    state.vertexPointer(m_vertex_buffer, 2, GL_FLOAT, sizeof(Vertex), 0);
+    state.enableTexCoordArray(true);
+    state.texCoordPointer(m_vertex_buffer, 2, GL_FLOAT, sizeof(Vertex), 2 * sizeof(float));
+    state.bindElementBuffer(m_index_buffer);
+    state.loadModelView(m_model_view);
+
+    auto quads = static_cast<GLsizei>(m_vertices.size() / 4);
+    glDrawElements(GL_TRIANGLES, quads * 6, GL_UNSIGNED_SHORT, nullptr);
+
+    m_vertices.clear();
+    ++m_draws;
+}
@@ -0,0 +1,65 @@
+#ifndef SPRITEBATCH_H
+#define SPRITEBATCH_H
+
+#include <cstdint>
+#include <vector>
+
+// Include GLEW
+#include <GL/glew.h>
+// Include GLM
+#include <glm/glm.hpp>
+
+#include "atlas.h"
+
+class GLStateCache;
+
+// Collects textured quads that sample one atlas and draws them with a single
+// glDrawElements. Positions and remapped atlas uvs are streamed into one vertex buffer
+// per flush, the quad index list is built once in init(). A batch is flushed by end(),
+// by begin() with another atlas, or when max_sprites quads are queued.
+class SpriteBatch
+{
+    struct Vertex
+    {
+        float x, y;
+        float u, v;
+    };
+
+    GLuint              m_vertex_buffer;
+    GLuint              m_index_buffer;
+    uint32_t            m_capacity;
+    GLStateCache *      mp_state;
+    GLuint              m_texture;
+    glm::mat4           m_model_view;
+    std::vector<Vertex> m_vertices;
+    // statistics
+    uint64_t m_sprites;
+    uint64_t m_draws;
+
+    void flush();
+
+public:
+    // 16-bit indices address at most 16384 quads
+    static constexpr uint32_t max_capacity = 16384;
+
+    SpriteBatch();
+
+    SpriteBatch(const SpriteBatch &) = delete;
+    SpriteBatch & operator=(const SpriteBatch &) = delete;
+
+    // init() and release() need the context current
+    bool init(uint32_t max_sprites = 4096);
+    void release();
+
+    // sprites go through the state cache, the caller sets up the projection
+    void begin(GLStateCache & state, GLuint atlas_texture, glm::mat4 const & model_view);
+    // draws region of the atlas over the rectangle (x, y) - (x + width, y + height)
+    void add(tex::AtlasRegion const & region, float x, float y, float width, float height);
+    void end();
+
+    uint64_t spriteCount() const { return m_sprites; }
+    uint64_t drawCalls() const { return m_draws; }
+    void     resetCounters() { m_sprites = m_draws = 0; }
+};
+
+#endif   // SPRITEBATCH_H
@@ -0,0 +1,246 @@
+#include "texturereload.h"
+#include "glstate.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+uint32_t BytesPerPixel(tex::ImageData const & id)
+{
+    return id.type == tex::ImageData::PixelType::pt_rgb ? 3 : 4;
+}
+}   // namespace
+
+TextureReloader::TextureReloader(size_t upload_budget) :
+    m_upload_budget{upload_budget},
+    m_stop{false},
+    m_reloads{0},
+    m_regions_uploaded{0},
+    m_bytes_uploaded{0}
+{
+    m_worker = std::thread(&TextureReloader::workerLoop, this);
+}
+
+TextureReloader::~TextureReloader()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    m_worker.join();
+}
+
+bool TextureReloader::track(std::string const & path, GLuint texture, tex::ImageData && image)
+{
+    if(!m_watcher.add(path))
+        return false;
+
+    auto e     = std::make_unique<Entry>();
+    e->path    = path;
+    e->texture = texture;
+    e->image   = std::move(image);
+    m_entries.push_back(std::move(e));
+
+    return true;
+}
+
+void TextureReloader::submit(Entry & e)
+{
+    e.busy  = true;
+    e.again = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(&e);
+    }
+    m_cv.notify_one();
+}
+
+void TextureReloader::workerLoop()
+{
+    for(;;)
+    {
+        Entry * e = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+            if(m_stop)
+                return;
+
+            e = m_jobs.front();
+            m_jobs.pop_front();
+        }
+
+        // the entry's path and image are not touched by the render thread while it is busy
+        Result res;
+        res.entry = e;
+        res.ok    = tex::ReadImage(e->path, res.image);
+
+        tex::ImageData const & old_img = e->image;
+        tex::ImageData const & new_img = res.image;
+        res.full = res.ok
+                   && (!old_img.data || old_img.width != new_img.width || old_img.height != new_img.height
+                       || old_img.type != new_img.type);
+
+        if(res.ok && !res.full)
+        {
+            uint32_t const bpp = BytesPerPixel(new_img);
+
+            for(uint32_t y0 = 0; y0 < new_img.height; y0 += tile_size)
+            {
+                uint32_t const h         = std::min(tile_size, new_img.height - y0);
+                uint32_t       run_start = new_img.width;   // none
+
+                for(uint32_t x0 = 0; x0 < new_img.width; x0 += tile_size)
+                {
+                    uint32_t const w     = std::min(tile_size, new_img.width - x0);
+                    bool           dirty = false;
+                    for(uint32_t y = y0; y < y0 + h && !dirty; ++y)
+                    {
+                        size_t offset = (static_cast<size_t>(y) * new_img.width + x0) * bpp;
+                        dirty = std::memcmp(old_img.data.get() + offset, new_img.data.get() + offset, w * bpp) != 0;
+                    }
+
+                    if(dirty && run_start == new_img.width)
+                    {
+                        run_start = x0;
+                    }
+                    else if(!dirty && run_start != new_img.width)
+                    {
+                        res.dirty.push_back(Region{run_start, y0, x0 - run_start, h});
+                        run_start = new_img.width;
+                    }
+                }
+
+                if(run_start != new_img.width)
+                    res.dirty.push_back(Region{run_start, y0, new_img.width - run_start, h});
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results.push_back(std::move(res));
+    }
+}
+
+bool TextureReloader::upload(Entry & e, GLStateCache & state, size_t & budget)
+{
+    tex::ImageData const & img    = e.next;
+    GLenum const           format = img.type == tex::ImageData::PixelType::pt_rgb ? GL_RGB : GL_RGBA;
+    uint32_t const         bpp    = BytesPerPixel(img);
+
+    state.bindTexture(e.texture);
+
+    // decoded rows are tightly packed, RGB rows of odd widths are not 4-byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if(e.full)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, img.type == tex::ImageData::PixelType::pt_rgb ? 3 : 4,
+                     static_cast<GLsizei>(img.width), static_cast<GLsizei>(img.height), 0, format, GL_UNSIGNED_BYTE,
+                     img.data.get());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        size_t bytes = static_cast<size_t>(img.width) * img.height * bpp;
+        budget -= std::min(budget, bytes);
+        m_bytes_uploaded += bytes;
+        ++m_regions_uploaded;
+
+        return true;
+    }
+
+    // sub-rectangles are read straight out of the full image
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(img.width));
+
+    bool progressed = false;
+    while(e.next_region < e.pending.size())
+    {
+        Region const & r     = e.pending[e.next_region];
+        size_t const   bytes = static_cast<size_t>(r.width) * r.height * bpp;
+        if(bytes > budget && progressed)
+            break;
+
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, static_cast<GLint>(r.x));
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, static_cast<GLint>(r.y));
+        glTexSubImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(r.x), static_cast<GLint>(r.y),
+                        static_cast<GLsizei>(r.width), static_cast<GLsizei>(r.height), format, GL_UNSIGNED_BYTE,
+                        img.data.get());
+
+        budget -= std::min(budget, bytes);
+        m_bytes_uploaded += bytes;
+        ++m_regions_uploaded;
+        ++e.next_region;
+        progressed = true;
+    }
+
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    return e.next_region == e.pending.size();
+}
+
+void TextureReloader::update(GLStateCache & state)
+{
+    m_changed.clear();
+    m_watcher.poll(m_changed);
+
+    for(auto const & path : m_changed)
+    {
+        for(auto & e : m_entries)
+        {
+            if(e->path != path)
+                continue;
+
+            if(e->busy)
+                e->again = true;
+            else
+                submit(*e);
+        }
+    }
+
+    std::deque<Result> results;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        results.swap(m_results);
+    }
+
+    for(auto & res : results)
+    {
+        Entry & e = *res.entry;
+        if(!res.ok)
+        {
+            // most likely caught the file half written, the next change event retries
+            e.busy = false;
+            if(e.again)
+                submit(e);
+            continue;
+        }
+
+        e.next        = std::move(res.image);
+        e.pending     = std::move(res.dirty);
+        e.next_region = 0;
+        e.full        = res.full;
+    }
+
+    size_t budget = m_upload_budget;
+    for(auto & ptr : m_entries)
+    {
+        Entry & e = *ptr;
+        if(!e.next.data)
+            continue;
+        if(budget == 0)
+            break;
+
+        if(!upload(e, state, budget))
+            continue;
+
+        e.image = std::move(e.next);
+        e.pending.clear();
+        e.busy = false;
+        ++m_reloads;
+
+        if(e.again)
+            submit(e);
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef TEXTURERELOAD_H
+#define TEXTURERELOAD_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Include GLEW
+#include <GL/glew.h>
+
+#include "filewatch.h"
+#include "imagedata.h"
+
+class GLStateCache;
+
+// Hot reload of textures. Changed files are re-decoded and diffed against the cached
+// ImageData on a worker thread in tile_size x tile_size tiles; the render thread then
+// re-uploads only the dirty tiles with glTexSubImage2D, at most upload_budget bytes per
+// frame. A change of size or pixel type re-creates the whole level.
+class TextureReloader
+{
+public:
+    static constexpr uint32_t tile_size = 64;
+
+private:
+    // horizontal run of dirty tiles
+    struct Region
+    {
+        uint32_t x, y, width, height;
+    };
+
+    struct Entry
+    {
+        std::string    path;
+        GLuint         texture = 0;
+        tex::ImageData image;          // what the texture holds now
+        bool           busy  = false;  // decoding or uploading
+        bool           again = false;  // changed again while busy
+        // upload in progress
+        tex::ImageData      next;
+        std::vector<Region> pending;
+        size_t              next_region = 0;
+        bool                full        = false;
+    };
+
+    struct Result
+    {
+        Entry *             entry = nullptr;
+        bool                ok    = false;
+        bool                full  = false;
+        tex::ImageData      image;
+        std::vector<Region> dirty;
+    };
+
+    FileWatcher                         m_watcher;
+    std::vector<std::unique_ptr<Entry>> m_entries;
+    std::vector<std::string>            m_changed;
+    size_t                              m_upload_budget;
+    // worker
+    std::thread             m_worker;
+    std::mutex              m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Entry *>     m_jobs;
+    std::deque<Result>      m_results;
+    bool                    m_stop;
+    // statistics
+    uint64_t m_reloads;
+    uint64_t m_regions_uploaded;
+    uint64_t m_bytes_uploaded;
+
+    void submit(Entry & e);
+    void workerLoop();
+    bool upload(Entry & e, GLStateCache & state, size_t & budget);
+
+public:
+    TextureReloader(size_t upload_budget = 4 * 1024 * 1024);
+    ~TextureReloader();
+
+    TextureReloader(const TextureReloader &) = delete;
+    TextureReloader & operator=(const TextureReloader &) = delete;
+
+    // image is the data the texture was created from; false if path can't be watched
+    bool track(std::string const & path, GLuint texture, tex::ImageData && image);
+    // render thread, once per frame
+    void update(GLStateCache & state);
+
+    uint64_t reloads() const { return m_reloads; }
+    uint64_t regionsUploaded() const { return m_regions_uploaded; }
+    uint64_t bytesUploaded() const { return m_bytes_uploaded; }
+};
+
+#endif   // TEXTURERELOAD_H
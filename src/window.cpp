@@ -2,6 +2,7 @@
 #include "imagedata.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <iostream>
 #include <stdexcept>
 
 // Our vertices. Tree consecutive floats give a 3D vertex; Three consecutive vertices give a triangle.
@@ -38,9 +39,11 @@ Window::Window(int width, int height, const char * title) :
     m_size{width, height},
     m_title{title},
     m_MV{1.0f},
-    m_vertexbuffer{0},
-    m_uvbuffer{0},
-    m_texture{0}
+    m_cube{},
+    m_texture{0},
+    m_texture_ticket{0},
+    m_profile_key_down{false},
+    m_record_key_down{false}
 {
     // Initialise GLFW
     if(!glfwInit())
@@ -56,9 +59,11 @@ Window::~Window()
     // Cleanup VBO and shader
     if(mp_glfw_win)
     {
-        glDeleteBuffers(1, &m_vertexbuffer);
-        glDeleteBuffers(1, &m_uvbuffer);
+        mesh::ReleaseMesh(m_cube);
         glDeleteTextures(1, &m_texture);
+        m_profiler.release();
+        m_capture.stop();
+        m_loader.stop();
     }
 
     // Close OpenGL window and terminate GLFW
@@ -92,6 +97,10 @@ void Window::create()
     GLFWwindow * new_window{nullptr};
     if(mp_glfw_win != nullptr)
     {
+        // query objects are not shared with the new context
+        m_profiler.release();
+        // the recording is bound to the old framebuffer size
+        m_capture.stop();
         new_window = glfwCreateWindow(width, height, "", mon, mp_glfw_win);
         glfwDestroyWindow(mp_glfw_win);
     }
@@ -119,6 +128,13 @@ void Window::create()
         throw std::runtime_error{"Failed to initialize GLEW"};
     }
 
+    m_profiler.init();
+    m_state.init();
+
+    // The loader context shares objects with the first window and, through it, with every
+    // window recreated from it
+    m_loader.start(mp_glfw_win);
+
     // Dark blue background
     glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
 
@@ -158,73 +174,160 @@ void Window::initScene()
     glm::mat4 Model = glm::mat4(1.0f);
     // Our ModelViewProjection : multiplication of our 3 matrices
     m_MV = View * Model;   // Remember, matrix multiplication is the other way around
+    // Frustum for culling, in world space
+    m_frustum = cull::ExtractFrustum(Projection * View);
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
 
-    // Load the texture
-    tex::ImageData tex_data;
-    if(!tex::ReadTGA("uvtemplate.tga", tex_data))
-        throw std::runtime_error{"Failed to load texture"};
-
-    glGenTextures(1, &m_texture);
-    glBindTexture(GL_TEXTURE_2D, m_texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, tex_data.type == tex::ImageData::PixelType::pt_rgb ? 3 : 4,
-                 static_cast<GLsizei>(tex_data.width), static_cast<GLsizei>(tex_data.height), 0,
-                 tex_data.type == tex::ImageData::PixelType::pt_rgb ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE,
-                 tex_data.data.get());
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    glGenBuffers(1, &m_vertexbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexbuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &m_uvbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, m_uvbuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(g_uv_buffer_data), g_uv_buffer_data, GL_STATIC_DRAW);
+    // Load the texture in the background, the cube is drawn untextured until it arrives
+    m_texture_ticket = m_loader.loadTexture("uvtemplate.tga", true);
+
+    // Load the cooked cube mesh, cook it from the arrays above if it is missing or can't be drawn here
+    mesh::MappedMesh cooked;
+    if(!cooked.open("cube.mesh") || !mesh::UploadMesh(cooked, m_cube))
+    {
+        mesh::MeshOptions opt;
+        opt.position_format = mesh::PositionFormat::pf_snorm16;
+        opt.texcoord_format =
+            GLEW_ARB_half_float_vertex ? mesh::TexCoordFormat::tf_half : mesh::TexCoordFormat::tf_float;
+
+        mesh::MeshData  md;
+        mesh::MeshStats st;
+        if(!mesh::BuildMesh(g_vertex_buffer_data, g_uv_buffer_data, 12 * 3, opt, md, &st)
+           || !mesh::UploadMesh(md, m_cube))
+            throw std::runtime_error{"Failed to build the cube mesh"};
+
+        std::cout << "Cube mesh: vertices " << st.source_vertices << " -> " << st.unique_vertices
+                  << ", vertex memory " << st.source_bytes << " -> " << st.vertex_bytes + st.index_bytes
+                  << " bytes, vertex shader invocations " << st.source_vertices << " -> " << st.invocations_optimized
+                  << " (" << st.invocations_indexed << " before reordering)" << std::endl;
+
+        if(!mesh::WriteMesh("cube.mesh", md))
+            std::cout << "Failed to write cube.mesh" << std::endl;
+    }
+
+    // Scene objects for culling, the cube is object 0
+    m_culler.build({cull::AABB{glm::vec3(-1.0f), glm::vec3(1.0f)}});
+
+    // the binds above went around the state cache
+    m_state.invalidate();
 }
 
-void Window::run()
+void Window::dumpProfile()
 {
+    if(!m_profiler.writeCSV("frame_profile.csv") || !m_profiler.writeJSON("frame_profile.json"))
+        std::cout << "Failed to write frame_profile.csv/.json" << std::endl;
+    std::cout << "GL state calls: issued " << m_state.issuedCalls() << ", elided " << m_state.elidedCalls()
+              << std::endl;
+}
+
+void Window::run(uint32_t max_frames)
+{
+    uint32_t frames{0};
     do
     {
         if(glfwGetKey(mp_glfw_win, GLFW_KEY_F1) == GLFW_PRESS)
             fullscreen(!m_is_fullscreen);
 
+        // Dump frame statistics once per press
+        bool profile_key_down = glfwGetKey(mp_glfw_win, GLFW_KEY_F2) == GLFW_PRESS;
+        if(profile_key_down && !m_profile_key_down)
+            dumpProfile();
+        m_profile_key_down = profile_key_down;
+
+        // Start/stop recording on the press only, holding F3 must not toggle every frame
+        bool record_key_down = glfwGetKey(mp_glfw_win, GLFW_KEY_F3) == GLFW_PRESS;
+        if(record_key_down && !m_record_key_down)
+        {
+            if(m_capture.isRecording())
+            {
+                m_capture.stop();
+            }
+            else
+            {
+                int width{0}, height{0};
+                glfwGetFramebufferSize(mp_glfw_win, &width, &height);
+                m_capture.start("capture_", width, height);
+            }
+        }
+        m_record_key_down = record_key_down;
+
+        m_profiler.beginFrame();
+
+        // Pick up finished background uploads and edited textures
+        m_profiler.beginPass("reload");
+        m_loaded.clear();
+        m_loader.poll(m_loaded);
+        for(auto & l : m_loaded)
+        {
+            // the names are ours, delete the ones nobody waits for anymore (0 is ignored)
+            if(l.ticket != m_texture_ticket)
+            {
+                if(l.target == GL_TEXTURE_2D)
+                    glDeleteTextures(1, &l.name);
+                else
+                    glDeleteBuffers(1, &l.name);
+                continue;
+            }
+            if(!l.ok)
+                throw std::runtime_error{"Failed to load texture"};
+
+            m_texture = l.name;
+            // Keep the decoded texture around so reloads only upload what changed
+            if(!m_reloader.track("uvtemplate.tga", m_texture, std::move(l.image)))
+                std::cout << "Texture hot reload is not available for uvtemplate.tga" << std::endl;
+        }
+        m_reloader.update(m_state);
+        m_profiler.endPass();
+
         // Clear the screen
+        m_profiler.beginPass("clear");
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        m_profiler.endPass();
 
-        glMatrixMode(GL_MODELVIEW);
-        glPushMatrix();
-        glMultMatrixf(glm::value_ptr(m_MV));
+        m_profiler.beginPass("draw");
 
-        glBindTexture(GL_TEXTURE_2D, m_texture);
+        m_queue.clear();
+        m_visible.clear();
+        m_culler.cull(m_frustum, m_visible);
 
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        for(uint32_t id : m_visible)
+        {
+            if(id != 0)
+                continue;
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_uvbuffer);
-        glTexCoordPointer(2, GL_FLOAT, 0, static_cast<char *>(nullptr));
-        glBindBuffer(GL_ARRAY_BUFFER, m_vertexbuffer);
-        glVertexPointer(3, GL_FLOAT, 0, static_cast<char *>(nullptr));
+            RenderCommand cube;
+            cube.texture = m_texture;
+            cube.mesh    = &m_cube;
+            cube.count   = m_cube.index_count;
+            m_queue.submit(cube, m_MV);
+        }
 
         // Draw the triangles !
-        glDrawArrays(GL_TRIANGLES, 0, 12 * 3);   // 12*3 indices starting at 0 -> 12 triangles
+        m_queue.sort();
+        m_queue.execute(m_state);
+        m_profiler.endPass();
 
-        glDisableClientState(GL_VERTEX_ARRAY);
-        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-        glPopMatrix();
+        if(m_capture.isRecording())
+        {
+            m_profiler.beginPass("capture");
+            m_capture.capture();
+            m_profiler.endPass();
+        }
 
         // Swap buffers
+        m_profiler.beginPass("swap");
         glfwSwapBuffers(mp_glfw_win);
+        m_profiler.endPass();
+
+        m_profiler.endFrame();
         glfwPollEvents();
 
+        if(max_frames > 0 && ++frames == max_frames)
+        {
+            dumpProfile();
+            break;
+        }
     }   // Check if the ESC key was pressed or the window was closed
     while(glfwGetKey(mp_glfw_win, GLFW_KEY_ESCAPE) != GLFW_PRESS && glfwWindowShouldClose(mp_glfw_win) == 0);
 }
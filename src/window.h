@@ -2,6 +2,7 @@
 #define WINDOW_H
 
 #include <string>
+#include <vector>
 
 // Include GLEW
 #include <GL/glew.h>
@@ -11,6 +12,15 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "asyncloader.h"
+#include "culling.h"
+#include "framecapture.h"
+#include "glstate.h"
+#include "gpuprofiler.h"
+#include "mesh.h"
+#include "renderqueue.h"
+#include "texturereload.h"
+
 class Window
 {
     // window state
@@ -20,10 +30,28 @@ class Window
     glm::ivec2          m_size;
     std::string         m_title;
     // scene state
-    glm::mat4 m_MV;
-    GLuint    m_vertexbuffer;
-    GLuint    m_uvbuffer;
-    GLuint    m_texture;
+    glm::mat4           m_MV;
+    mesh::Mesh          m_cube;
+    GLuint              m_texture;
+    AsyncLoader::Ticket m_texture_ticket;
+    // visibility
+    cull::Frustum         m_frustum;
+    cull::Bvh             m_culler;
+    std::vector<uint32_t> m_visible;
+    // rendering
+    GLStateCache    m_state;
+    RenderQueue     m_queue;
+    TextureReloader m_reloader;
+    // background uploads
+    AsyncLoader                      m_loader;
+    std::vector<AsyncLoader::Loaded> m_loaded;
+    // frame profiling and recording
+    GpuProfiler  m_profiler;
+    FrameCapture m_capture;
+    bool         m_profile_key_down;
+    bool         m_record_key_down;
+
+    void dumpProfile();
 
 public:
     Window(int width, int height, const char * title);
@@ -32,12 +60,16 @@ public:
     Window(const Window &) = delete;
     Window & operator=(const Window &) = delete;
 
-    bool isFullscreen() const { return m_is_fullscreen; }
+    bool                isFullscreen() const { return m_is_fullscreen; }
+    GpuProfiler const & profiler() const { return m_profiler; }
+    FrameCapture &      capture() { return m_capture; }
 
     void create();
     void initScene();
     void fullscreen(bool is_fullscreen);
-    void run();
+    // runs until ESC or the window is closed; with max_frames > 0 it also stops after that
+    // many frames and dumps the profile, so a fixed run can be compared between builds
+    void run(uint32_t max_frames = 0);
 };
 
 #endif   // WINDOW_H